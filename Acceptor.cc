@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 
 /**
  * @brief 创建一个非阻塞的、用于监听的TCP socket。
@@ -40,8 +41,15 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     : //loop_(loop), //【已在您上一步修复】这里不再需要保存loop_, 因为它只在构造Channel时使用一次
       acceptSocket_(createNonblocking()), // 创建监听socket, 并用Socket类进行封装, 实现RAII
       acceptChannel_(loop, acceptSocket_.fd()), // 创建一个Channel, 专门负责监听 acceptSocket_ 上的事件
-      listening_(false) // 初始状态为未监听
+      listening_(false), // 初始状态为未监听
+      acceptBatch_(kDefaultAcceptBatch),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) // 预留一个fd, 用于fd耗尽时丢弃连接
 {
+    if (idleFd_ < 0)
+    {
+        LOG_ERROR("%s:%s:%d open idle fd err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+
     // 设置服务器socket的标准选项
     acceptSocket_.setReuseAddr(true);   // 开启地址复用
     acceptSocket_.setReusePort(reuseport); // 根据传入参数决定是否开启端口复用
@@ -65,6 +73,10 @@ Acceptor::~Acceptor()
     acceptChannel_.disableAll();
     // 将Channel从Poller的监听列表中彻底移除
     acceptChannel_.remove();
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
 }
 
 /**
@@ -81,39 +93,83 @@ void Acceptor::listen()
 /**
  * @brief 处理监听socket上的读事件(即新连接的到来)。
  * 这个函数是 acceptChannel_ 的回调函数, 由 EventLoop 在检测到新连接时调用。
+ * 一次最多接受 acceptBatch_ 个连接, 没取完的连接留给下一轮循环(监听fd是水平触发的)。
  */
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr; // 用于接收客户端的地址信息
-    
-    // 调用 acceptSocket_ 的 accept 方法, 接受新连接并返回一个用于通信的 connfd
-    int connfd = acceptSocket_.accept(&peerAddr);
-
-    if (connfd >= 0) // 成功接受一个新连接
+    int dropped = 0;
+    for (int i = 0; i < acceptBatch_; ++i)
     {
-        // 检查用户是否设置了“新连接回调”函数
-        if (newConnectionCallback_)
+        InetAddress peerAddr; // 用于接收客户端的地址信息
+
+        // 调用 acceptSocket_ 的 accept 方法, 接受新连接并返回一个用于通信的 connfd
+        int connfd = acceptSocket_.accept(&peerAddr);
+
+        if (connfd >= 0) // 成功接受一个新连接
+        {
+            // 检查用户是否设置了“新连接回调”函数
+            if (newConnectionCallback_)
+            {
+                // 如果设置了, 就调用它, 将新连接的 connfd 和客户端地址 peerAddr 交给上层(通常是TcpServer)处理
+                // 【任务交接】Acceptor 的工作到此结束, 后续的数据处理完全交给 TcpServer 和 TcpConnection
+                newConnectionCallback_(connfd, peerAddr);
+            }
+            else
+            {
+                // 如果用户没有设置回调, 说明无法处理这个新连接,
+                // 必须立即关闭 connfd, 否则会造成文件描述符泄漏
+                ::close(connfd);
+            }
+            continue;
+        }
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
         {
-            // 如果设置了, 就调用它, 将新连接的 connfd 和客户端地址 peerAddr 交给上层(通常是TcpServer)处理
-            // 【任务交接】Acceptor 的工作到此结束, 后续的数据处理完全交给 TcpServer 和 TcpConnection
-            newConnectionCallback_(connfd, peerAddr);
+            break; // 全连接队列已经取空
         }
-        else
+        if (savedErrno == EINTR || savedErrno == ECONNABORTED || savedErrno == EPROTO)
         {
-            // 如果用户没有设置回调, 说明无法处理这个新连接,
-            // 必须立即关闭 connfd, 否则会造成文件描述符泄漏
-            ::close(connfd);
+            continue; // 被信号中断, 或者连接在 accept 之前就被对端重置了
         }
+        if (savedErrno == EMFILE || savedErrno == ENFILE)
+        {
+            // 文件描述符耗尽, 用预留的fd丢弃队列中的连接, 避免水平触发的监听fd让loop空转
+            if (dropConnectionWithIdleFd())
+            {
+                ++dropped;
+                continue;
+            }
+        }
+        // 其他错误(如 ENOBUFS、ENOMEM)留到下一轮循环再试
+        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+        break;
     }
-    else // accept 失败
+
+    if (dropped > 0)
     {
-        // 记录错误日志
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        // 如果错误是 EMFILE, 意味着文件描述符耗尽
-        if (errno == EMFILE)
+        LOG_ERROR("%s:%s:%d sockfd reached limit, dropped %d connections\n",
+                  __FILE__, __FUNCTION__, __LINE__, dropped);
+    }
+}
+
+bool Acceptor::dropConnectionWithIdleFd()
+{
+    if (idleFd_ < 0)
+    {
+        // 上次重新打开失败, 再试一次
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (idleFd_ < 0)
         {
-            LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
-            // 在这里可以添加更高级的错误处理逻辑, 以避免服务器因fd耗尽而陷入“忙循环”
+            return false;
         }
     }
-}
\ No newline at end of file
+    ::close(idleFd_);
+    int connfd = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+    if (connfd >= 0)
+    {
+        ::close(connfd);
+    }
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return connfd >= 0;
+}
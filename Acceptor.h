@@ -19,12 +19,33 @@ public:
     bool listening() const { return listening_; }
     void listen();
 
+    /**
+     * @brief 设置每次读事件最多 accept 的连接数。
+     * @details 一次唤醒循环调用 accept4 直到返回 EAGAIN 或达到上限,
+     * 连接风暴时不必为每个连接都经历一次 epoll_wait。上限避免 accept 长时间占用 mainLoop。
+     * @param batch 不小于1, 默认 kDefaultAcceptBatch。
+     */
+    void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+    int acceptBatch() const { return acceptBatch_; }
+
+    static const int kDefaultAcceptBatch = 64;
+
 private:
     void handleRead();
+    /**
+     * @brief 文件描述符耗尽(EMFILE/ENFILE)时, 用预留的 fd 接受一个连接并立即关闭。
+     * @details 水平触发的监听 fd 上还有未取走的连接, 如果什么都不做, loop 会一直被唤醒空转。
+     * 先关闭预留的 fd 腾出一个位置, accept 后马上关闭, 客户端看到的是连接被关闭而不是一直挂起。
+     * @return 是否成功丢弃了一个连接。
+     */
+    bool dropConnectionWithIdleFd();
 
     // EventLoop *loop_; // Acceptor用的就是用户定义的baseLoop，也就是mainLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listening_;
+    int acceptBatch_;
+    /// @brief 预留的空闲 fd(打开的 /dev/null), 只在 fd 耗尽时使用
+    int idleFd_;
 };
@@ -1,9 +1,24 @@
 #include "Buffer.h"
+#include "ByteSearch.h"
 
 #include <errno.h>
+#include <limits.h>  // for IOV_MAX
+#include <string.h>
 #include <sys/uio.h> // for readv
 #include <unistd.h>  // for read
 
+const size_t Buffer::kChunkSize;
+
+namespace
+{
+// 数据块的最后一个引用释放时, 把它还给当前线程的 BufferPool
+struct ChunkDeleter
+{
+    size_t capacity;
+    void operator()(char *block) const { BufferPool::deallocate(block, capacity); }
+};
+} // namespace
+
 /**
  * @brief 从文件描述符(socket)读取数据并存入缓冲区。
  * @details
@@ -17,41 +32,89 @@
  */
 ssize_t Buffer::readFd(int fd, int *savedErrno)
 {
-    // 在栈上创建一个临时的额外缓冲区
+    // 在栈上创建一个临时的额外缓冲区, 只读一次
     char extraBuf[65536]; // 64K
+    int syscalls = 0;
+    return readFd(fd, savedErrno, extraBuf, sizeof(extraBuf), 0, &syscalls);
+}
 
-    struct iovec vec[2];
-    const size_t writable = writableBytes();
+/**
+ * @brief 循环版本的 readFd, 使用调用方提供的临时区(通常是 EventLoop 的读临时区)。
+ * @details
+ * 每次 readv 先填 Buffer 的可写空间, 放不下的部分进入 extraBuf 再 append。
+ * 如果一次 readv 把提供的空间全部填满, 说明内核中很可能还有数据, 就继续读;
+ * 出现短读、EAGAIN、对端关闭, 或者累计读取达到 maxBytes 时停止。
+ * 短读之后不再多做一次注定返回 EAGAIN 的系统调用。
+ */
+ssize_t Buffer::readFd(int fd, int *savedErrno, char *extraBuf, size_t extraSize,
+                       size_t maxBytes, int *syscalls)
+{
+    ssize_t total = 0;
+    ssize_t n = 0;
+    *syscalls = 0;
+    while (true)
+    {
+        if (!chunked_ && buffer_ == nullptr)
+        {
+            // 还没有分配内存(刚创建或者刚被读空), 先分配初始块, 让数据直接读进 Buffer
+            makeSpace(0);
+        }
 
-    // 第一块缓冲区指向 Buffer 内部的可写空间
-    vec[0].iov_base = begin() + writerIndex_;
-    vec[0].iov_len = writable;
-    // 第二块缓冲区指向栈上的临时空间
-    vec[1].iov_base = extraBuf;
-    vec[1].iov_len = sizeof(extraBuf);
+        struct iovec vec[2];
+        const size_t writable = writableBytes();
+        int iovcnt = 0;
 
-    // 当 Buffer 的可写空间足够大时, 一次 readv 就能读完所有数据,
-    // 如果不够, 就会读到栈上的 extraBuf 中, 然后再 append 到 Buffer 中。
-    const int iovcnt = (writable < sizeof(extraBuf)) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+        // 第一块缓冲区指向 Buffer 内部的可写空间(分段模式下是最后一个块的空闲处)
+        if (writable > 0)
+        {
+            vec[iovcnt].iov_base = beginWrite();
+            vec[iovcnt].iov_len = writable;
+            ++iovcnt;
+        }
+        // 第二块缓冲区指向临时空间
+        // 当 Buffer 的可写空间足够大时, 一次 readv 就能读完所有数据,
+        // 如果不够, 就会读到 extraBuf 中, 然后再 append 到 Buffer 中。
+        size_t extra = 0;
+        if (writable < extraSize)
+        {
+            extra = extraSize;
+            vec[iovcnt].iov_base = extraBuf;
+            vec[iovcnt].iov_len = extraSize;
+            ++iovcnt;
+        }
+        n = ::readv(fd, vec, iovcnt);
+        ++*syscalls;
 
-    if (n < 0)
-    {
-        *savedErrno = errno;
-    }
-    else if (static_cast<size_t>(n) <= writable)
-    {
-        // 读取的数据只占用了 Buffer 的可写空间
-        writerIndex_ += n;
-    }
-    else
-    {
-        // Buffer 的可写空间已全部用完, 并且数据还写入了 extraBuf
-        writerIndex_ = buffer_.size();
-        // 将 extraBuf 中的数据追加到 Buffer 中 (这会触发 makeSpace 和 vector 的扩容)
-        append(extraBuf, n - writable);
+        if (n < 0)
+        {
+            *savedErrno = errno;
+            break;
+        }
+        else if (n == 0)
+        {
+            break; // 对端关闭。如果前面已经读到数据, 下一次读取还会再遇到它
+        }
+        else if (static_cast<size_t>(n) <= writable)
+        {
+            // 读取的数据只占用了 Buffer 的可写空间
+            hasWritten(n);
+        }
+        else
+        {
+            // Buffer 的可写空间已全部用完, 并且数据还写入了 extraBuf
+            hasWritten(writable);
+            // 将 extraBuf 中的数据追加到 Buffer 中 (连续模式会触发 makeSpace 和扩容, 分段模式只是挂上新块)
+            append(extraBuf, n - writable);
+        }
+
+        total += n;
+        if (static_cast<size_t>(n) < writable + extra || static_cast<size_t>(total) >= maxBytes)
+        {
+            break; // 短读(内核中的数据已经读完), 或者预算用完
+        }
     }
-    return n;
+    // 已经读到数据时, 之后遇到的错误或 EOF 留到下一次读取处理(错误码仍通过 savedErrno 带出)
+    return total > 0 ? total : n;
 }
 
 /**
@@ -72,6 +135,18 @@ ssize_t Buffer::readFd(int fd, int *savedErrno)
  */
 ssize_t Buffer::writeFd(int fd, int *savedErrno)
 {
+    if (chunked_)
+    {
+        // 分段模式: 把各个块收集成 iovec, 一次 writev 发出, 不需要先合并
+        struct iovec iov[IOV_MAX];
+        int iovcnt = peekIovec(iov, IOV_MAX);
+        ssize_t n = ::writev(fd, iov, iovcnt);
+        if (n < 0)
+        {
+            *savedErrno = errno;
+        }
+        return n;
+    }
     ssize_t n = ::write(fd, peek(), readableBytes());
     if (n < 0)
     {
@@ -85,15 +160,34 @@ ssize_t Buffer::writeFd(int fd, int *savedErrno)
  * @details
  * 这是一个核心的性能优化。它首先检查 "已读空间 + 可写空间" 是否足够,
  * 如果足够, 就将可读数据前移, 复用已读空间, 避免内存分配。
- * 如果总空间仍然不足, 才进行 vector 的扩容。
+ * 如果总空间仍然不足, 才从 BufferPool 换一个更大的块。
  * @param len 需要的最小可写空间。
  */
 void Buffer::makeSpace(size_t len)
 {
+    if (buffer_ == nullptr)
+    {
+        // 第一次写入才分配内存; 池中的块大小是分级的, 多出来的部分也可以使用
+        capacity_ = BufferPool::roundUp(kCheapPrepend + std::max(len, initialSize_));
+        buffer_ = BufferPool::allocate(capacity_);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend;
+        return;
+    }
+
     // 如果 "已读空间 + 可写空间" < "需要的空间 + 预留空间", 说明总空间不足, 必须扩容
     if (writableBytes() + prependableBytes() < len + kCheapPrepend)
     {
-        buffer_.resize(writerIndex_ + len);
+        // 从池中取一个更大的块(级别按2的幂增长), 顺便把可读数据挪到前端
+        size_t readable = readableBytes();
+        size_t newCapacity = BufferPool::roundUp(kCheapPrepend + readable + len);
+        char *newBuffer = BufferPool::allocate(newCapacity);
+        memcpy(newBuffer + kCheapPrepend, begin() + readerIndex_, readable);
+        BufferPool::deallocate(buffer_, capacity_);
+        buffer_ = newBuffer;
+        capacity_ = newCapacity;
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
     }
     else // 总空间足够, 只是需要整理
     {
@@ -106,4 +200,265 @@ void Buffer::makeSpace(size_t len)
         readerIndex_ = kCheapPrepend;
         writerIndex_ = readerIndex_ + readable;
     }
-}
\ No newline at end of file
+}
+
+void Buffer::setChunked(bool on)
+{
+    assert(readableBytes() == 0);
+    if (on == chunked_)
+    {
+        return;
+    }
+    chunked_ = on;
+    segments_.clear();
+    releaseStorage();
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+}
+
+int Buffer::peekIovec(struct iovec *iov, int maxIov) const
+{
+    if (!chunked_)
+    {
+        if (readableBytes() == 0 || maxIov <= 0)
+        {
+            return 0;
+        }
+        iov[0].iov_base = const_cast<char *>(peek());
+        iov[0].iov_len = readableBytes();
+        return 1;
+    }
+
+    int count = 0;
+    for (const Segment &seg : segments_)
+    {
+        if (count >= maxIov)
+        {
+            break;
+        }
+        iov[count].iov_base = seg.data;
+        iov[count].iov_len = seg.len;
+        ++count;
+    }
+    return count;
+}
+
+Buffer::Segment Buffer::newSegment(size_t minCapacity)
+{
+    Segment seg;
+    seg.capacity = BufferPool::roundUp(minCapacity);
+    seg.data = BufferPool::allocate(seg.capacity);
+    seg.owner = std::shared_ptr<char>(seg.data, ChunkDeleter{seg.capacity});
+    seg.len = 0;
+    return seg;
+}
+
+void Buffer::addChunk(size_t minSize)
+{
+    // 一般都是定长块; 超过定长块大小的请求(如 ensureWritableBytes(64K))单独分配一块
+    segments_.push_back(newSegment(std::max(minSize, kChunkSize)));
+}
+
+void Buffer::appendChunked(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (!tailAppendable())
+        {
+            addChunk(kChunkSize);
+        }
+        Segment &tail = segments_.back();
+        size_t n = std::min(len, tail.capacity - tail.len);
+        memcpy(tail.data + tail.len, data, n);
+        tail.len += n;
+        chunkedBytes_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void Buffer::appendShared(std::shared_ptr<void> owner, const char *data, size_t len)
+{
+    if (!chunked_)
+    {
+        append(data, len);
+        return;
+    }
+    if (len == 0)
+    {
+        return;
+    }
+    // 容量等于长度, 这个块永远不会被追加数据, 外部内存只会被读取
+    Segment seg;
+    seg.owner = std::move(owner);
+    seg.data = const_cast<char *>(data);
+    seg.len = len;
+    seg.capacity = len;
+    segments_.push_back(std::move(seg));
+    chunkedBytes_ += len;
+}
+
+void Buffer::append(Buffer *other)
+{
+    if (other->readableBytes() == 0)
+    {
+        return;
+    }
+    if (readableBytes() == 0 && chunked_ == other->chunked_)
+    {
+        swap(*other);
+        other->retrieveAll();
+        return;
+    }
+
+    if (chunked_ && other->chunked_)
+    {
+        for (Segment &seg : other->segments_)
+        {
+            segments_.push_back(std::move(seg));
+        }
+        chunkedBytes_ += other->chunkedBytes_;
+        other->segments_.clear();
+        other->chunkedBytes_ = 0;
+    }
+    else if (chunked_)
+    {
+        // 接管对方的整块连续内存, 作为一个数据块挂在末尾, 最后还给池的仍然是这整块内存
+        Segment seg;
+        seg.owner = std::shared_ptr<char>(other->buffer_, ChunkDeleter{other->capacity_});
+        seg.data = other->buffer_ + other->readerIndex_;
+        seg.len = other->readableBytes();
+        seg.capacity = other->capacity_ - other->readerIndex_;
+        chunkedBytes_ += seg.len;
+        segments_.push_back(std::move(seg));
+        other->buffer_ = nullptr;
+        other->capacity_ = 0;
+        other->readerIndex_ = kCheapPrepend;
+        other->writerIndex_ = kCheapPrepend;
+    }
+    else
+    {
+        // 本缓冲区是连续模式, 只能拷贝
+        if (other->chunked_)
+        {
+            for (const Segment &seg : other->segments_)
+            {
+                append(seg.data, seg.len);
+            }
+        }
+        else
+        {
+            append(other->peek(), other->readableBytes());
+        }
+        other->retrieveAll();
+    }
+}
+
+const char *Buffer::findCRLF(const char *start) const
+{
+    const char *end = peek() + readableBytes();
+    assert(peek() <= start && start <= end);
+    return ByteSearch::findCRLF(start, end);
+}
+
+const char *Buffer::findEOL(const char *start) const
+{
+    const char *end = peek() + readableBytes();
+    assert(peek() <= start && start <= end);
+    return ByteSearch::findByte(start, end, '\n');
+}
+
+const char *Buffer::findByte(char c) const
+{
+    return ByteSearch::findByte(peek(), peek() + readableBytes(), c);
+}
+
+const char *Buffer::findAny(std::string_view set) const
+{
+    return ByteSearch::findAny(peek(), peek() + readableBytes(), set.data(), set.size());
+}
+
+const char *Buffer::findCRLF(size_t *scanned) const
+{
+    const char *begin = peek();
+    size_t readable = readableBytes();
+    // "\r\n" 可能正好跨在上次扫描的边界上, 从边界前一个字节开始
+    size_t from = *scanned > 0 ? std::min(*scanned - 1, readable) : 0;
+    const char *crlf = ByteSearch::findCRLF(begin + from, begin + readable);
+    *scanned = crlf != nullptr ? 0 : readable;
+    return crlf;
+}
+
+const char *Buffer::findEOL(size_t *scanned) const
+{
+    const char *begin = peek();
+    size_t readable = readableBytes();
+    size_t from = std::min(*scanned, readable);
+    const char *eol = ByteSearch::findByte(begin + from, begin + readable, '\n');
+    *scanned = eol != nullptr ? 0 : readable;
+    return eol;
+}
+
+void Buffer::retainFront(size_t len, std::vector<std::shared_ptr<void>> *owners) const
+{
+    assert(chunked_);
+    for (const Segment &seg : segments_)
+    {
+        if (len == 0)
+        {
+            break;
+        }
+        owners->push_back(seg.owner);
+        len -= std::min(len, seg.len);
+    }
+}
+
+void Buffer::prependChunked(const void *data, size_t len)
+{
+    // 在最前面放一个新块, 已有的块不需要移动。它不是最后一块, 不会被追加数据
+    Segment seg = newSegment(len);
+    seg.len = len;
+    memcpy(seg.data, data, len);
+    segments_.push_front(std::move(seg));
+    chunkedBytes_ += len;
+}
+
+void Buffer::retrieveChunked(size_t len)
+{
+    chunkedBytes_ -= len;
+    while (len > 0)
+    {
+        Segment &front = segments_.front();
+        if (len < front.len)
+        {
+            front.data += len;
+            front.len -= len;
+            front.capacity -= len;
+            return;
+        }
+        len -= front.len;
+        segments_.pop_front(); // 最后一个引用释放时数据块被回收
+    }
+}
+
+const char *Buffer::linearize() const
+{
+    if (segments_.empty())
+    {
+        static const char kEmpty[1] = {0};
+        return kEmpty;
+    }
+    if (segments_.size() > 1)
+    {
+        // 合并成一块, 并留出一个定长块的空闲以便后续追加
+        Segment merged = newSegment(std::max(chunkedBytes_, kChunkSize));
+        for (const Segment &seg : segments_)
+        {
+            memcpy(merged.data + merged.len, seg.data, seg.len);
+            merged.len += seg.len;
+        }
+        segments_.clear();
+        segments_.push_back(std::move(merged));
+    }
+    return segments_.front().data;
+}
@@ -1,9 +1,19 @@
 #pragma once
 
-#include <vector>
+#include "noncopyable.h"
+#include "BufferPool.h"
+
+#include <deque>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <algorithm> // for std::copy
 #include <cassert>   // for assert
+#include <string.h>  // for memcpy
+#include <stdint.h>
+#include <endian.h>  // for htobe32 等字节序转换
+#include <sys/uio.h> // for iovec
 
 // 网络库底层的缓冲区类型定义
 //
@@ -14,7 +24,19 @@
 // |                   |                  |                  |
 // 0      <=      readerIndex_    <=    writerIndex_    <=     size()
 //
-class Buffer
+// 分段模式(setChunked)下不使用上面的连续数组, 数据保存在一串引用计数的定长数据块中:
+//
+// +---------------+   +---------------+   +---------------+
+// | chunk (4K)    |-->| chunk (4K)    |-->| chunk  | free |
+// +---------------+   +---------------+   +---------------+
+//
+// append 只会在最后一个块的空闲处追加或者新挂一个块, 已有的数据永远不会被移动;
+// writeFd 把所有块收集成 iovec 用一次 writev 发出。
+//
+// 两种模式的内存都来自线程私有的 BufferPool: 构造时不分配, 第一次写入时才分配;
+// 数据被全部消费后立即把内存还给池, 空闲的连接不占用缓冲区内存。
+//
+class Buffer : noncopyable
 {
 public:
     // kCheapPrepend 是预留给消息头的空间。比如我们可以在数据前添加一个4字节的长度信息。
@@ -22,41 +44,126 @@ public:
     static const size_t kCheapPrepend = 8;
     // 缓冲区的初始大小
     static const size_t kInitialSize = 1024;
+    // 分段模式下每个数据块的大小
+    static const size_t kChunkSize = 4096;
 
     /**
      * @brief 构造函数, 创建一个带有预留空间的缓冲区。
-     * @param initialSize 缓冲区的初始容量。
+     * @param initialSize 缓冲区的初始容量, 在第一次写入时才真正分配。
      */
     explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize),
+        : buffer_(nullptr),
+          capacity_(0),
+          initialSize_(initialSize),
           readerIndex_(kCheapPrepend),
-          writerIndex_(kCheapPrepend)
+          writerIndex_(kCheapPrepend),
+          chunked_(false),
+          chunkedBytes_(0)
+    {
+    }
+
+    Buffer(Buffer &&rhs) noexcept
+        : Buffer(rhs.initialSize_)
+    {
+        swap(rhs);
+    }
+
+    Buffer &operator=(Buffer &&rhs) noexcept
+    {
+        Buffer tmp(std::move(rhs));
+        swap(tmp);
+        return *this;
+    }
+
+    ~Buffer()
     {
+        BufferPool::deallocate(buffer_, capacity_);
     }
 
+    /**
+     * @brief 切换到分段模式。
+     * @details 适合输出缓冲区: 追加大块数据时不会 resize + 拷贝, 发送时用 writev 一次发出多个块。
+     * peek()/retrieve() 等接口保持可用, 但 peek() 需要把所有块合并成一块连续内存,
+     * 只应该用在需要连续协议头的解析场景; 发送数据请使用 writeFd() 或 peekIovec()。
+     * @note 只能在缓冲区为空时切换。
+     */
+    void setChunked(bool on);
+    bool chunked() const { return chunked_; }
+
     // --- 以下是您已完成的 '只读' 接口 ---
 
     size_t readableBytes() const
     {
-        return writerIndex_ - readerIndex_;
+        return chunked_ ? chunkedBytes_ : writerIndex_ - readerIndex_;
     }
 
     size_t writableBytes() const
     {
-        return buffer_.size() - writerIndex_;
+        if (chunked_)
+        {
+            // 只有本缓冲区独占的最后一个块才能继续追加
+            return tailAppendable() ? segments_.back().capacity - segments_.back().len : 0;
+        }
+        return buffer_ != nullptr ? capacity_ - writerIndex_ : 0;
     }
 
     size_t prependableBytes() const
     {
-        return readerIndex_;
+        // 分段模式下前置数据会放进一个新块, 总是能容纳 kCheapPrepend 字节
+        return chunked_ ? kCheapPrepend : readerIndex_;
     }
 
     // 获取可读数据的起始地址
+    // 分段模式下会先把所有块合并成一块连续内存(不改变内容, 所以仍然是 const 的)
     const char *peek() const
     {
-        return begin() + readerIndex_;
+        if (chunked_)
+        {
+            return linearize();
+        }
+        return buffer_ != nullptr ? begin() + readerIndex_ : "";
     }
 
+    /**
+     * @brief 把可读数据描述成最多 maxIov 个 iovec, 不拷贝数据, 也不消费数据。
+     * @details 连续模式下只有一段; 分段模式下每个块一段。
+     * @return int 填充的 iovec 个数。
+     */
+    int peekIovec(struct iovec *iov, int maxIov) const;
+
+    /**
+     * @brief 获取前 len 字节可读数据所在内存块的引用, 让它们在内核异步读取期间保持有效(如 MSG_ZEROCOPY)。
+     * @details 被引用的块不会再被追加数据, 也不会被还给池, 直到引用释放。
+     * @note 只适用于分段模式, 连续模式的内存会被移动和复用, 不能这样持有。
+     */
+    void retainFront(size_t len, std::vector<std::shared_ptr<void>> *owners) const;
+
+    // --- 在可读数据中查找分隔符(向量化实现见 ByteSearch), 返回的指针位于可读区域内, 没找到返回 nullptr ---
+    // 分段模式下会先通过 peek() 合并所有块, 这些接口主要用于输入缓冲区。
+
+    /// @brief 查找 "\r\n", 返回指向 '\r' 的位置
+    const char *findCRLF() const { return findCRLF(peek()); }
+    /// @brief 从 start(必须位于可读区域内)开始查找 "\r\n"
+    const char *findCRLF(const char *start) const;
+    /// @brief 查找 '\n'
+    const char *findEOL() const { return findEOL(peek()); }
+    const char *findEOL(const char *start) const;
+    /// @brief 查找字节 c
+    const char *findByte(char c) const;
+    /// @brief 查找 set 中任意一个字节
+    const char *findAny(std::string_view set) const;
+
+    /**
+     * @brief 可恢复的查找, 用于逐步到达的数据(例如一行一行到来的请求头)。
+     * @details 每次只扫描上次之后新到达的数据, 解析的总开销与数据量成正比,
+     * 而不是每来一点数据就从 peek() 开始重新扫描一遍。
+     * @param scanned [输入输出参数] 已经确认不含分隔符的可读字节数, 第一次调用前置0。
+     * 没找到时更新为本次扫描到的位置, 找到时自动置0。
+     * 如果在没找到时 retrieve 了数据, 调用方需要把它减去相应的长度。
+     */
+    const char *findCRLF(size_t *scanned) const;
+    const char *findEOL(size_t *scanned) const;
+
     // --- 以下是需要补全的 '消费/写入/读取' 核心接口 ---
 
     /**
@@ -69,8 +176,18 @@ public:
      */
     void prepend(const void *data, size_t len)
     {
+        if (chunked_)
+        {
+            prependChunked(data, len);
+            return;
+        }
+
         // 1. 安全检查: 确保要添加的头部长度, 不超过当前头部预留空间的大小。
         assert(len <= prependableBytes());
+        if (buffer_ == nullptr)
+        {
+            makeSpace(0); // 还没有分配内存, 先分配初始块
+        }
 
         // 2. 核心操作: 将读指针向前移动 len 个位置, "腾出"空间。
         readerIndex_ -= len;
@@ -89,6 +206,11 @@ public:
     {
         // 断言确保要消费的长度不大于可读数据长度
         assert(len <= readableBytes());
+        if (chunked_)
+        {
+            retrieveChunked(len);
+            return;
+        }
         if (len < readableBytes())
         {
             readerIndex_ += len; // 只是移动读指针, 不进行内存操作
@@ -99,14 +221,34 @@ public:
         }
     }
 
+    /**
+     * @brief 消费掉 [peek(), end) 之间的数据, 通常与 findCRLF() 等查找接口配合使用。
+     * @param end 位于可读区域内的指针。
+     */
+    void retrieveUntil(const char *end)
+    {
+        assert(peek() <= end);
+        assert(end <= peek() + readableBytes());
+        retrieve(end - peek());
+    }
+
     /**
      * @brief 消费掉所有可读数据。
      */
     void retrieveAll()
     {
+        if (chunked_)
+        {
+            segments_.clear();
+            chunkedBytes_ = 0;
+            return;
+        }
         // 将读写指针重置到初始位置, 缓冲区清空
         readerIndex_ = kCheapPrepend;
         writerIndex_ = kCheapPrepend;
+        // 数据已经全部消费, 把内存还给池, 下次写入时再分配。
+        // 同时也回收了突发流量时扩容出来的大块内存。
+        releaseStorage();
     }
 
     /**
@@ -126,7 +268,21 @@ public:
     std::string retrieveAsString(size_t len)
     {
         assert(len <= readableBytes());
-        std::string result(peek(), len);
+        std::string result;
+        if (chunked_)
+        {
+            // 逐块拷贝, 不需要先合并成连续内存
+            result.reserve(len);
+            for (size_t i = 0; result.size() < len; ++i)
+            {
+                const Segment &seg = segments_[i];
+                result.append(seg.data, std::min(seg.len, len - result.size()));
+            }
+        }
+        else
+        {
+            result.assign(peek(), len);
+        }
         retrieve(len); // 从缓冲区中移除已读取的数据
         return result;
     }
@@ -137,6 +293,14 @@ public:
      */
     void ensureWritableBytes(size_t len)
     {
+        if (chunked_)
+        {
+            if (writableBytes() < len)
+            {
+                addChunk(len);
+            }
+            return;
+        }
         if (writableBytes() < len)
         {
             makeSpace(len); // 如果可写空间不足, 则进行空间整理或扩容
@@ -151,11 +315,156 @@ public:
      */
     void append(const char *data, size_t len)
     {
+        if (chunked_)
+        {
+            appendChunked(data, len);
+            return;
+        }
         ensureWritableBytes(len);
         std::copy(data, data + len, begin() + writerIndex_);
         writerIndex_ += len;
     }
 
+    /**
+     * @brief 把一块外部内存作为只读块挂到缓冲区末尾, 不拷贝数据。
+     * @details owner 管理这块内存的生命周期, 这段数据被消费、并且其他引用都释放之后它才会被释放。
+     * 连续模式下退化为普通的 append 拷贝。
+     */
+    void appendShared(std::shared_ptr<void> owner, const char *data, size_t len);
+
+    /**
+     * @brief 把 other 的全部可读数据移动到本缓冲区末尾, other 随后为空。
+     * @details
+     * 本缓冲区为空且两者模式相同时直接交换; 本缓冲区是分段模式时直接接管 other 的数据块
+     * (连续模式的 other 整块内存变成一个数据块), 都不拷贝数据。只有本缓冲区是连续模式时才需要拷贝。
+     */
+    void append(Buffer *other);
+
+    /// @brief 可写区域的起始地址, 用于把缓冲区直接交给内核写入(如异步recv)
+    /// @note 内存是按需分配的, 使用前需要先调用 ensureWritableBytes()(分段模式下指向最后一个块的空闲处)
+    char *beginWrite() { return chunked_ ? segments_.back().data + segments_.back().len : begin() + writerIndex_; }
+    const char *beginWrite() const { return chunked_ ? segments_.back().data + segments_.back().len : begin() + writerIndex_; }
+
+    /**
+     * @brief 确认有 len 字节的数据已经被直接写入了 beginWrite() 处。
+     */
+    void hasWritten(size_t len)
+    {
+        assert(len <= writableBytes());
+        if (chunked_)
+        {
+            segments_.back().len += len;
+            chunkedBytes_ += len;
+            return;
+        }
+        writerIndex_ += len;
+    }
+
+    // --- 网络字节序(大端)整数的读写, 用于二进制协议的长度头、类型字段等 ---
+    // peekIntXX 不消费数据, readIntXX 读取后消费; 调用前可读数据必须足够。
+
+    int8_t peekInt8() const
+    {
+        assert(readableBytes() >= sizeof(int8_t));
+        return static_cast<int8_t>(*peek());
+    }
+    int16_t peekInt16() const
+    {
+        assert(readableBytes() >= sizeof(int16_t));
+        uint16_t be16 = 0;
+        memcpy(&be16, peek(), sizeof be16);
+        return static_cast<int16_t>(be16toh(be16));
+    }
+    int32_t peekInt32() const
+    {
+        assert(readableBytes() >= sizeof(int32_t));
+        uint32_t be32 = 0;
+        memcpy(&be32, peek(), sizeof be32);
+        return static_cast<int32_t>(be32toh(be32));
+    }
+    int64_t peekInt64() const
+    {
+        assert(readableBytes() >= sizeof(int64_t));
+        uint64_t be64 = 0;
+        memcpy(&be64, peek(), sizeof be64);
+        return static_cast<int64_t>(be64toh(be64));
+    }
+
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieve(sizeof result);
+        return result;
+    }
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieve(sizeof result);
+        return result;
+    }
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieve(sizeof result);
+        return result;
+    }
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    void appendInt8(int8_t x) { append(reinterpret_cast<const char *>(&x), sizeof x); }
+    void appendInt16(int16_t x)
+    {
+        uint16_t be16 = htobe16(static_cast<uint16_t>(x));
+        append(reinterpret_cast<const char *>(&be16), sizeof be16);
+    }
+    void appendInt32(int32_t x)
+    {
+        uint32_t be32 = htobe32(static_cast<uint32_t>(x));
+        append(reinterpret_cast<const char *>(&be32), sizeof be32);
+    }
+    void appendInt64(int64_t x)
+    {
+        uint64_t be64 = htobe64(static_cast<uint64_t>(x));
+        append(reinterpret_cast<const char *>(&be64), sizeof be64);
+    }
+
+    // prependIntXX 写入头部预留空间, 最多 kCheapPrepend(8) 字节, 正好放得下一个 int64
+    void prependInt8(int8_t x) { prepend(&x, sizeof x); }
+    void prependInt16(int16_t x)
+    {
+        uint16_t be16 = htobe16(static_cast<uint16_t>(x));
+        prepend(&be16, sizeof be16);
+    }
+    void prependInt32(int32_t x)
+    {
+        uint32_t be32 = htobe32(static_cast<uint32_t>(x));
+        prepend(&be32, sizeof be32);
+    }
+    void prependInt64(int64_t x)
+    {
+        uint64_t be64 = htobe64(static_cast<uint64_t>(x));
+        prepend(&be64, sizeof be64);
+    }
+
+    /**
+     * @brief 与另一个缓冲区交换内容, 不拷贝数据。
+     */
+    void swap(Buffer &rhs)
+    {
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(initialSize_, rhs.initialSize_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+        std::swap(chunked_, rhs.chunked_);
+        segments_.swap(rhs.segments_);
+        std::swap(chunkedBytes_, rhs.chunkedBytes_);
+    }
+
     /**
      * @brief 从文件描述符(socket)读取数据并存入缓冲区。
      * @param fd 要读取的文件描述符。
@@ -164,19 +473,38 @@ public:
      */
     ssize_t readFd(int fd, int *savedErrno);
 
-    // 通过fd发送数据
+    /**
+     * @brief 从文件描述符循环读取数据, 直到短读、EAGAIN、对端关闭或者读满 maxBytes。
+     * @param extraBuf 可写空间不足时使用的临时区, 调用期间独占使用。
+     * @param maxBytes 本次最多读取的字节数(按整次 readv 计算, 可能略微超出), 0 表示只读一次。
+     * @param syscalls [输出参数] 本次调用 readv 的次数。
+     * @return ssize_t 读取到的总字节数。一个字节都没读到时, -1表示错误, 0表示对端关闭连接;
+     * 读到数据之后遇到的错误码也会写入 savedErrno。
+     */
+    ssize_t readFd(int fd, int *savedErrno, char *extraBuf, size_t extraSize,
+                   size_t maxBytes, int *syscalls);
+
+    // 通过fd发送数据, 不消费数据; 分段模式下用一次 writev 发送最多 IOV_MAX 个块
     ssize_t writeFd(int fd,int *savedErrno);
 
 private:
     // 获取缓冲区起始地址
     char *begin()
     {
-        return &*buffer_.begin();
+        return buffer_;
     }
 
     const char *begin() const
     {
-        return &*buffer_.begin();
+        return buffer_;
+    }
+
+    /// @brief 把连续模式的内存还给池
+    void releaseStorage()
+    {
+        BufferPool::deallocate(buffer_, capacity_);
+        buffer_ = nullptr;
+        capacity_ = 0;
     }
 
     /**
@@ -185,7 +513,48 @@ private:
      */
     void makeSpace(size_t len);
 
-    std::vector<char> buffer_;
+    /// @brief 分段模式下的一段可读数据
+    struct Segment
+    {
+        /// @brief 数据所在内存块的引用计数
+        std::shared_ptr<void> owner;
+        /// @brief 可读数据的起始地址
+        char *data;
+        /// @brief 可读数据的长度
+        size_t len;
+        /// @brief 从 data 到块尾的总字节数, 大于 len 的部分可以继续追加
+        size_t capacity;
+    };
+
+    // --- 分段模式的实现, 见 Buffer.cc ---
+    bool tailAppendable() const
+    {
+        return !segments_.empty() && segments_.back().owner.use_count() == 1 &&
+               segments_.back().len < segments_.back().capacity;
+    }
+    /// @brief 从池中分配一个至少能容纳 minCapacity 字节的数据块
+    static Segment newSegment(size_t minCapacity);
+    /// @brief 在尾部挂一个至少能容纳 minSize 字节的新块
+    void addChunk(size_t minSize);
+    void appendChunked(const char *data, size_t len);
+    void prependChunked(const void *data, size_t len);
+    void retrieveChunked(size_t len);
+    /// @brief 把所有块合并成一块, 返回它的起始地址
+    const char *linearize() const;
+
+    /// @brief 连续模式的内存, 来自 BufferPool, 为空表示尚未分配
+    char *buffer_;
+    /// @brief buffer_ 的容量
+    size_t capacity_;
+    /// @brief 第一次分配时的初始容量
+    size_t initialSize_;
     size_t readerIndex_;
     size_t writerIndex_;
+
+    /// @brief 是否处于分段模式
+    bool chunked_;
+    /// @brief 分段模式下的数据块。linearize() 只改变存储方式而不改变内容, 因此是 mutable 的
+    mutable std::deque<Segment> segments_;
+    /// @brief 分段模式下的可读字节总数
+    size_t chunkedBytes_;
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "BufferPool.h"
+
+#include <stdlib.h>
+#include <new>
+
+namespace
+{
+// 级别数: 1K ... 1M
+const int kNumClasses = 11;
+// 每个级别最多缓存的字节数
+const size_t kMaxCachedBytesPerClass = 4 * 1024 * 1024;
+
+// 线程退出时 ThreadCache 析构之后, 其他线程局部对象的析构函数仍可能释放块, 这时直接交给 free()
+thread_local bool t_cacheDestroyed = false;
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+/**
+ * @brief 线程私有的空闲链表, 线程退出时把缓存的块全部还给系统。
+ */
+struct ThreadCache
+{
+    ThreadCache()
+    {
+        for (int i = 0; i < kNumClasses; ++i)
+        {
+            heads[i] = nullptr;
+            cachedBytes[i] = 0;
+        }
+    }
+
+    ~ThreadCache()
+    {
+        t_cacheDestroyed = true;
+        for (int i = 0; i < kNumClasses; ++i)
+        {
+            while (heads[i] != nullptr)
+            {
+                FreeBlock *block = heads[i];
+                heads[i] = block->next;
+                ::free(block);
+            }
+        }
+    }
+
+    FreeBlock *heads[kNumClasses];
+    size_t cachedBytes[kNumClasses];
+};
+
+ThreadCache *threadCache()
+{
+    if (t_cacheDestroyed)
+    {
+        return nullptr;
+    }
+    static thread_local ThreadCache cache;
+    return &cache;
+}
+
+int classIndex(size_t blockSize)
+{
+    int index = 0;
+    size_t size = BufferPool::kMinBlockSize;
+    while (size < blockSize)
+    {
+        size <<= 1;
+        ++index;
+    }
+    return index;
+}
+} // namespace
+
+size_t BufferPool::roundUp(size_t size)
+{
+    if (size > kMaxBlockSize)
+    {
+        return size;
+    }
+    size_t blockSize = kMinBlockSize;
+    while (blockSize < size)
+    {
+        blockSize <<= 1;
+    }
+    return blockSize;
+}
+
+char *BufferPool::allocate(size_t size)
+{
+    size_t blockSize = roundUp(size);
+    ThreadCache *cache = blockSize <= kMaxBlockSize ? threadCache() : nullptr;
+    if (cache != nullptr)
+    {
+        int index = classIndex(blockSize);
+        FreeBlock *block = cache->heads[index];
+        if (block != nullptr)
+        {
+            cache->heads[index] = block->next;
+            cache->cachedBytes[index] -= blockSize;
+            return reinterpret_cast<char *>(block);
+        }
+    }
+    void *p = ::malloc(blockSize);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return static_cast<char *>(p);
+}
+
+void BufferPool::deallocate(char *block, size_t size)
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+    size_t blockSize = roundUp(size);
+    ThreadCache *cache = blockSize <= kMaxBlockSize ? threadCache() : nullptr;
+    if (cache != nullptr)
+    {
+        int index = classIndex(blockSize);
+        if (cache->cachedBytes[index] + blockSize <= kMaxCachedBytesPerClass)
+        {
+            FreeBlock *freeBlock = reinterpret_cast<FreeBlock *>(block);
+            freeBlock->next = cache->heads[index];
+            cache->heads[index] = freeBlock;
+            cache->cachedBytes[index] += blockSize;
+            return;
+        }
+    }
+    ::free(block);
+}
+
+size_t BufferPool::cachedBytes()
+{
+    ThreadCache *cache = threadCache();
+    size_t total = 0;
+    for (int i = 0; cache != nullptr && i < kNumClasses; ++i)
+    {
+        total += cache->cachedBytes[i];
+    }
+    return total;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Buffer 存储使用的按尺寸分级的线程私有内存池。
+ * @details
+ * 块大小按2的幂分级(1K, 2K, 4K ... 1M), 每个线程每个级别维护一个空闲链表,
+ * 释放的块直接挂回当前线程的链表, 分配时优先从链表取, 整个过程不加锁、不进入 malloc。
+ * 由于 one loop per thread, 线程私有的池也就是每个 EventLoop 私有的池。
+ * 每个级别缓存的总字节数有上限, 超出的块直接归还给系统, 突发流量过后内存不会被一直占着。
+ * 超过最大级别的请求直接使用 malloc/free。
+ *
+ * @note 块在一个线程分配、在另一个线程释放是安全的, 它只会进入释放线程的缓存。
+ */
+class BufferPool : noncopyable
+{
+public:
+    /// @brief 最小的块大小
+    static const size_t kMinBlockSize = 1024;
+    /// @brief 最大的池化块大小, 更大的请求不经过池
+    static const size_t kMaxBlockSize = 1024 * 1024;
+
+    /**
+     * @brief 计算 size 所属级别的块大小(不小于 size 的2的幂, 至少 kMinBlockSize)。
+     * @note allocate(size) 实际得到的容量就是 roundUp(size), 调用方可以使用全部容量。
+     */
+    static size_t roundUp(size_t size);
+
+    /**
+     * @brief 分配一个容量为 roundUp(size) 的块。
+     */
+    static char *allocate(size_t size);
+
+    /**
+     * @brief 归还一个块。
+     * @param size 分配时的 size 或者 roundUp(size)。
+     */
+    static void deallocate(char *block, size_t size);
+
+    /// @brief 当前线程的池中缓存的空闲字节数
+    static size_t cachedBytes();
+};
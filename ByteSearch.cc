@@ -0,0 +1,179 @@
+#include "ByteSearch.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SIMD 1
+#endif
+
+namespace
+{
+using CrlfFunc = const char *(*)(const char *, const char *);
+using AnyFunc = const char *(*)(const char *, const char *, const char *, size_t);
+
+const char *findCRLFScalar(const char *begin, const char *end)
+{
+    for (const char *p = begin; p + 1 < end; ++p)
+    {
+        if (p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+const char *findAnyScalar(const char *begin, const char *end, const char *set, size_t setLen)
+{
+    // 256位的查找表, 每个字节一次查表
+    uint64_t table[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < setLen; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(set[i]);
+        table[c >> 6] |= uint64_t(1) << (c & 63);
+    }
+    for (const char *p = begin; p < end; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (table[c >> 6] & (uint64_t(1) << (c & 63)))
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef MYMUDUO_X86_SIMD
+// '\r' 的比较结果和后移一个字节的 '\n' 的比较结果相与, 一次检查16/32个起始位置。
+// 第二次加载多读一个字节, 因此循环条件要保证 p + 宽度 + 1 <= end。
+
+__attribute__((target("sse2")))
+const char *findCRLFSse2(const char *begin, const char *end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char *p = begin;
+    for (; end - p >= 17; p += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+const char *findCRLFAvx2(const char *begin, const char *end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char *p = begin;
+    for (; end - p >= 33; p += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFSse2(p, end);
+}
+
+__attribute__((target("sse4.2")))
+const char *findAnySse42(const char *begin, const char *end, const char *set, size_t setLen)
+{
+    if (setLen > 16)
+    {
+        return findAnyScalar(begin, end, set, setLen);
+    }
+    char setBytes[16] = {0};
+    memcpy(setBytes, set, setLen);
+    const __m128i needles = _mm_loadu_si128(reinterpret_cast<const __m128i *>(setBytes));
+    const int needleLen = static_cast<int>(setLen);
+    const char *p = begin;
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i haystack = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int index = _mm_cmpestri(needles, needleLen, haystack, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (index < 16)
+        {
+            return p + index;
+        }
+    }
+    return findAnyScalar(p, end, set, setLen);
+}
+#endif
+
+struct Dispatch
+{
+    Dispatch()
+        : crlf(findCRLFScalar),
+          any(findAnyScalar),
+          name("scalar")
+    {
+#ifdef MYMUDUO_X86_SIMD
+        __builtin_cpu_init();
+        crlf = findCRLFSse2;
+        name = "sse2";
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            any = findAnySse42;
+            name = "sse4.2";
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            crlf = findCRLFAvx2;
+            name = __builtin_cpu_supports("sse4.2") ? "avx2+sse4.2" : "avx2";
+        }
+#endif
+    }
+
+    CrlfFunc crlf;
+    AnyFunc any;
+    const char *name;
+};
+
+const Dispatch &dispatch()
+{
+    static const Dispatch d;
+    return d;
+}
+} // namespace
+
+const char *ByteSearch::findByte(const char *begin, const char *end, char c)
+{
+    if (begin >= end)
+    {
+        return nullptr;
+    }
+    return static_cast<const char *>(memchr(begin, c, end - begin));
+}
+
+const char *ByteSearch::findCRLF(const char *begin, const char *end)
+{
+    return dispatch().crlf(begin, end);
+}
+
+const char *ByteSearch::findAny(const char *begin, const char *end, const char *set, size_t setLen)
+{
+    if (setLen == 1)
+    {
+        return findByte(begin, end, set[0]);
+    }
+    return dispatch().any(begin, end, set, setLen);
+}
+
+const char *ByteSearch::implementation()
+{
+    return dispatch().name;
+}
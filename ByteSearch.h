@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Buffer 查找分隔符使用的字节扫描函数。
+ * @details
+ * x86 上根据 CPU 支持的指令集在第一次调用时选择实现(AVX2 / SSE4.2 / SSE2),
+ * 其他平台使用逐字节的标量实现。所有函数都只读取 [begin, end) 范围内的内存。
+ * 返回找到的位置, 没找到时返回 nullptr。
+ */
+struct ByteSearch
+{
+    /// @brief 查找字节 c, 直接使用 memchr(glibc 的 memchr 本身就是按 CPU 分派的向量实现)
+    static const char *findByte(const char *begin, const char *end, char c);
+
+    /// @brief 查找 "\r\n", 返回指向 '\r' 的位置
+    static const char *findCRLF(const char *begin, const char *end);
+
+    /**
+     * @brief 查找 set 中任意一个字节第一次出现的位置。
+     * @details 不超过16个字节的集合使用 SSE4.2 的 PCMPESTRI 一次比较16个字节,
+     * 更大的集合使用256位的查找表。
+     */
+    static const char *findAny(const char *begin, const char *end, const char *set, size_t setLen);
+
+    /// @brief 当前使用的实现的名字, 用于日志和压测
+    static const char *implementation();
+};
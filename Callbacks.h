@@ -32,6 +32,9 @@ using MessageCallback = std::function<void(const TcpConnectionPtr &,
 
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
 
+// 定时器回调函数: 定时器到期时, 在所属 EventLoop 的线程中被调用
+using TimerCallback = std::function<void()>;
+
 // 这是一个空的占位类, 当前文件中主要的作用是提供一个统一的头文件名,
 // 所有的回调都定义在这里。
 class Callbacks
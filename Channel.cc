@@ -5,6 +5,7 @@
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeTriggeredEvents = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLRDHUP | EPOLLET;
 
 Channel::Channel(EventLoop *loop, int fd)
     : loop_(loop),
@@ -12,7 +13,9 @@ Channel::Channel(EventLoop *loop, int fd)
       events_(0),
       revents_(0),
       index_(-1),
-      tied_(false)
+      tied_(false),
+      edgeTriggered_(false),
+      edgeRegistered_(false)
 {
 }
 
@@ -40,6 +43,16 @@ void Channel::remove()
  */
 void Channel::update()
 {
+    // 边缘触发模式下注册的事件是固定的, 只有在“无事件”和“有事件”之间切换时才需要通知 Poller
+    if (edgeTriggered_)
+    {
+        bool registered = events_ != kNoneEvent;
+        if (registered == edgeRegistered_)
+        {
+            return;
+        }
+        edgeRegistered_ = registered;
+    }
 
     // 实现 updateChannel 函数，通过 EventLoop 调用 Poller 的相应方法，注册 fd 的 events 事件
     loop_->updateChannel(this);
@@ -80,14 +93,15 @@ void Channel::handleEventWithGuard(Timestamp reveiveTime)
             errorCallback_();
         }
     }
-    if(revents_&(EPOLLIN|EPOLLPRI))
+    // 边缘触发模式下内核总是报告全部事件, 只分发当前关心的那些
+    if((revents_&(EPOLLIN|EPOLLPRI|EPOLLRDHUP))&&isReading())
     {
         if(readCallback_)
         {
             readCallback_(reveiveTime);
         }
     }
-    if(revents_&(EPOLLOUT))
+    if((revents_&(EPOLLOUT))&&isWriting())
     {
         if(writeCallback_)
         {
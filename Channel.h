@@ -2,6 +2,7 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "InplaceFunction.h"
 
 #include <functional>
 #include <memory>
@@ -26,10 +27,10 @@ class EventLoop;
 class Channel : noncopyable
 {
 public:
-    /// @brief 定义了一个通用的、无参数的事件回调函数类型。
-    using EventCallback = std::function<void()>;
+    /// @brief 定义了一个通用的、无参数的事件回调函数类型。只能移动, 小的绑定对象不会分配堆内存。
+    using EventCallback = InplaceFunction<void()>;
     /// @brief 定义了专门用于读事件的回调函数类型, 它会接收事件发生的时间戳。
-    using ReadEventCallback = std::function<void(Timestamp)>;
+    using ReadEventCallback = InplaceFunction<void(Timestamp)>;
 
     /**
      * @brief 构造函数。
@@ -111,6 +112,31 @@ public:
         update();
     }
 
+    /**
+     * @brief 切换到边缘触发模式。
+     * @details
+     * 之后 fd 只会以 EPOLLIN|EPOLLPRI|EPOLLOUT|EPOLLRDHUP|EPOLLET 向 Poller 注册一次,
+     * enable/disableReading/Writing 只修改本地记录的“关心”的事件, 不再调用 epoll_ctl;
+     * 只有在“无事件”和“有事件”之间切换时(例如 disableAll())才会真正更新 Poller。
+     * 内核报告的事件中, 只有当前关心的才会分发给对应的回调。
+     * @note 回调必须一直读/写到 EAGAIN, 否则不会再收到通知;
+     * 不关心期间到来的边缘会被丢弃, 重新关心时需要自己先尝试一次读/写。
+     * 只能用于支持边缘触发的 Poller(见 EventLoop::edgeTriggeredSupported())。
+     */
+    void enableEdgeTriggered()
+    {
+        edgeTriggered_ = true;
+        edgeRegistered_ = false;
+        update();
+    }
+    bool isEdgeTriggered() const { return edgeTriggered_; }
+
+    /**
+     * @brief 实际注册到 Poller 中的事件。
+     * @details 水平触发时就是 events(); 边缘触发时只要关心任何事件, 就是固定的一组边缘触发事件。
+     */
+    int pollEvents() const { return (edgeTriggered_ && events_ != kNoneEvent) ? kEdgeTriggeredEvents : events_; }
+
     // --- 查询当前监听状态的接口 ---
     bool isNoneEvent() const { return events_ == kNoneEvent; }
     bool isWriting() const { return events_ & kWriteEvent; }
@@ -148,6 +174,7 @@ private:
     static const int kNoneEvent;  // 0
     static const int kReadEvent;  // EPOLLIN | EPOLLPRI
     static const int kWriteEvent; // EPOLLOUT
+    static const int kEdgeTriggeredEvents; // EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLRDHUP | EPOLLET
 
     /// @brief 所属的 EventLoop, Channel 的所有操作都会在其中进行。
     EventLoop *loop_; 
@@ -164,6 +191,10 @@ private:
     std::weak_ptr<void> tie_;
     /// @brief 标记是否启用了 tie_ 机制。
     bool tied_;
+    /// @brief 是否处于边缘触发模式。
+    bool edgeTriggered_;
+    /// @brief 边缘触发模式下, 固定的事件是否已经注册到 Poller。
+    bool edgeRegistered_;
 
     // --- 事件回调函数成员 ---
     ReadEventCallback readCallback_;
@@ -1,5 +1,7 @@
 #include "Poller.h"
 #include "EPollPoller.h" // 👈 需要包含具体 "epoll" 实现的头文件
+#include "IoUringPoller.h"
+#include "Logger.h"
 // #include "PollPoller.h" // 👈 如果您也实现了 PollPoller, 也需要包含它的头文件
 
 #include <stdlib.h> // 👈 需要包含此头文件以使用 ::getenv
@@ -11,18 +13,43 @@
  */
 Poller *Poller::newDefaultPoller(EventLoop *loop)
 {
-    // ::getenv 用于获取一个环境变量的值
-    // 这是一个运行时选择机制, 允许用户通过设置环境变量来强制使用 poll
-    if (::getenv("MUDUO_USE_POLL"))
+    return newPoller(loop, kDefaultBackend);
+}
+
+/**
+ * @brief 按指定的后端创建 Poller。
+ * @details
+ * kDefaultBackend 是一个运行时选择机制, 允许用户通过设置环境变量来切换实现:
+ * - MUDUO_USE_IOURING: 使用 io_uring (内核不支持时退回 epoll);
+ * - MUDUO_USE_POLL: 尚未实现 PollPoller, 退回 epoll。
+ */
+Poller *Poller::newPoller(EventLoop *loop, Backend backend)
+{
+    if (backend == kDefaultBackend)
     {
-        // 如果用户在环境中设置了 MUDUO_USE_POLL=1 (或任何值)
-        // 就返回一个 PollPoller 的实例 (这里我们先用 nullptr 占位)
-        // return new PollPoller(loop); 
-        return nullptr; // 假设您尚未实现 PollPoller
+        // ::getenv 用于获取一个环境变量的值
+        if (::getenv("MUDUO_USE_IOURING"))
+        {
+            backend = kIoUringBackend;
+        }
+        else
+        {
+            if (::getenv("MUDUO_USE_POLL"))
+            {
+                LOG_INFO("PollPoller is not implemented, fall back to EPollPoller\n");
+            }
+            backend = kEPollBackend;
+        }
     }
-    else
+
+    if (backend == kIoUringBackend)
     {
-        // 否则, 默认在 Linux 上返回 EPollPoller 的实例
-        return new EPollPoller(loop);
+        if (IoUringPoller::isSupported())
+        {
+            return new IoUringPoller(loop);
+        }
+        LOG_ERROR("io_uring is not supported by this kernel, fall back to EPollPoller\n");
     }
-}
\ No newline at end of file
+    // 默认在 Linux 上返回 EPollPoller 的实例
+    return new EPollPoller(loop);
+}
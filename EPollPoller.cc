@@ -44,8 +44,8 @@ EPollPoller::~EPollPoller()
  */
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    // 实际上调用LOG_DEBUG更为合理
-    LOG_INFO("func=%s => fd total count: %lu\n", __FUNCTION__, channels_.size());
+    // 开启忙轮询后每轮循环可能调用成千上万次, 只在调试时输出
+    LOG_DEBUG("func=%s => fd total count: %lu\n", __FUNCTION__, numChannels_);
 
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
@@ -54,7 +54,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 
     if (numEvents > 0)
     {
-        LOG_INFO("%d events happened \n", numEvents);
+        LOG_DEBUG("%d events happened \n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == static_cast<int>(events_.size()))
         {
@@ -117,13 +117,12 @@ void EPollPoller::updateChannel(Channel *channel)
 
     if (index == kNew || index == kDeleted)
     {
-        int fd = channel->fd();
         if (index == kNew)
         {
-            // 只有当 Channel 是全新的，才需要将它添加到 map 中
-            channels_[fd] = channel;
+            // 只有当 Channel 是全新的，才需要将它放入fd对应的槽位, 同时槽位换代
+            addChannelSlot(channel);
         }
-        // 对于 kDeleted 状态，它已经存在于 map 中，所以不需要做任何 map 操作
+        // 对于 kDeleted 状态，它已经存在于槽位中，所以不需要做任何操作
 
         channel->set_index(kAdded);
         update(EPOLL_CTL_ADD, channel);
@@ -150,7 +149,7 @@ void EPollPoller::updateChannel(Channel *channel)
 void EPollPoller::removeChannel(Channel *channel)
 {
     int fd = channel->fd();
-    channels_.erase(fd);
+    removeChannelSlot(fd);
 
     LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
 
@@ -171,9 +170,16 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
 {
     for (int i = 0; i < numEvents; ++i)
     {
-        Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
+        // data.u64 中是注册时的 fd 和槽位代数, 代数不一致说明这是一个已经被移除的旧 Channel 的事件
+        int fd = static_cast<int>(events_[i].data.u64 & 0xFFFFFFFF);
+        uint32_t generation = static_cast<uint32_t>(events_[i].data.u64 >> 32);
+        Channel *channel = findChannel(fd);
+        if (channel == nullptr || generationOf(fd) != generation)
+        {
+            continue;
+        }
         channel->set_revents(events_[i].events);
-        activeChannels->push_back(channel); // EventLoop拿到了它的Poller给它返回的所有发生事件的channel列表
+        activeChannels->push_back(ActiveChannel{channel, fd, generation}); // EventLoop拿到了它的Poller给它返回的所有发生事件的channel列表
     }
 }
 
@@ -207,9 +213,9 @@ void EPollPoller::update(int operation, Channel *channel)
     memset(&event, 0, sizeof event);
 
     int fd = channel->fd();
-    event.events = channel->events();
-    event.data.ptr = channel;
-    // event.data.fd = fd;
+    event.events = channel->pollEvents();
+    // 不保存 Channel 指针, 而是保存 fd 和槽位代数, 取事件时在 channels_ 中查表并校验
+    event.data.u64 = (static_cast<uint64_t>(generationOf(fd)) << 32) | static_cast<uint32_t>(fd);
 
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
@@ -17,6 +17,7 @@ public:
     Timestamp poll(int timeoutMs, ChannelList *activeChannels) override; // 等待IO事件
     void updateChannel(Channel *channel) override;                       // 在Poller中更新通道
     void removeChannel(Channel *channel) override;                       // 从Poller中移除通道
+    bool edgeTriggeredSupported() const override { return true; }        // epoll 原生支持 EPOLLET
 
 private:
     static const int kInitEventListSize = 16; // events_数组的初始大小
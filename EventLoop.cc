@@ -2,12 +2,15 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "IoUringPoller.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <algorithm>
 // 防止一个线程创建多个EventLoop对象
 thread_local EventLoop *t_loopInThisThread = nullptr;
 
@@ -25,14 +28,28 @@ int createEventfd()
     return evtfd;
 }
 
-EventLoop::EventLoop()
+EventLoop::EventLoop(Poller::Backend backend)
     : looping_(false),
       quit_(false),
       threadId_(CurrentThread::tid()),           // ← 按声明顺序排在 callingPendingFunctors_ 之前
-      poller_(Poller::newDefaultPoller(this)),
+      poller_(Poller::newPoller(this, backend)),
+      ioUringPoller_(dynamic_cast<IoUringPoller *>(poller_.get())),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
-      callingPendingFunctors_(false)             // ← 现在排在最后，和声明顺序一致
+      timerQueue_(new TimerQueue(this)),
+      callingPendingFunctors_(false),            // ← 现在排在最后，和声明顺序一致
+      parked_(false),
+      wakeupCount_(0),
+      queuedTaskCount_(0),
+      busyPollMaxUs_(0),
+      spinWindowUs_(0),
+      arrivalGapUs_(0),
+      spinHitCount_(0),
+      blockingWaitCount_(0),
+      readBytes_(0),
+      readSyscallCount_(0),
+      bufferedBytes_(0),
+      numConnections_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
     if (t_loopInThisThread)
@@ -50,8 +67,29 @@ EventLoop::EventLoop()
     wakeupChannel_->enableReading();
 }
 
+const size_t EventLoop::kReadArenaSize;
+
+char *EventLoop::readArena()
+{
+    if (!readArena_)
+    {
+        readArena_.reset(new char[kReadArenaSize]);
+    }
+    return readArena_.get();
+}
+
+EventLoop *EventLoop::getEventLoopOfCurrentThread()
+{
+    return t_loopInThisThread;
+}
+
 EventLoop::~EventLoop()
 {
+    if (ioUringPoller_ != nullptr)
+    {
+        // 先让内核交还所有收发缓冲区, 回调释放的连接在析构时还会访问本对象的其他成员
+        ioUringPoller_->cancelAllOperations();
+    }
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
 
@@ -69,10 +107,41 @@ void EventLoop::loop()
     while (!quit_)
     {
         activeChannels_.clear();
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
-        for (Channel *channel : activeChannels_)
+
+        // 忙轮询: 先自旋一段时间, 自旋期间IO线程一直醒着, 生产者不需要唤醒它
+        if (!(spinWindowUs_.load(std::memory_order_relaxed) > 0 && pendingFunctors_.empty() && spinPoll()))
+        {
+            // 先声明“我要睡了”, 再检查任务队列。与 wakeupIfParked() 中“先入队, 再检查 parked_”配对,
+            // 两边之间的 seq_cst 屏障保证: 要么这里看到了新任务, 要么生产者看到了 parked_ 并唤醒我们。
+            int timeoutMs = kPollTimeMs;
+            parked_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!pendingFunctors_.empty())
+            {
+                // 已经有任务在排队(包括本线程在回调中投递的任务), 不必睡眠, 也不需要别人来唤醒
+                parked_.store(false, std::memory_order_relaxed);
+                timeoutMs = 0;
+            }
+
+            // Poller 在 epoll_wait 返回后取一次时间, 作为本轮循环缓存的“当前时间”
+            pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+            parked_.store(false, std::memory_order_relaxed);
+            if (busyPollMaxUs_ > 0 && timeoutMs != 0)
+            {
+                blockingWaitCount_.fetch_add(1, std::memory_order_relaxed);
+                if (!activeChannels_.empty())
+                {
+                    updateSpinWindow(Timestamp::monotonicNow());
+                }
+            }
+        }
+        for (const Poller::ActiveChannel &active : activeChannels_)
         {
-            channel->handleEvent(pollReturnTime_);
+            // 前面的回调可能已经移除了这个 Channel, 甚至fd已被新连接复用, 这时丢弃过期的事件
+            if (poller_->isCurrent(active))
+            {
+                active.channel->handleEvent(pollReturnTime_);
+            }
         }
         // 执行当前EventLoop事件循环需要处理的回调操作
         doPendingFunctors();
@@ -82,6 +151,54 @@ void EventLoop::loop()
     looping_ = false;
 }
 
+void EventLoop::setBusyPoll(int maxSpinMicroseconds)
+{
+    busyPollMaxUs_ = maxSpinMicroseconds > 0 ? maxSpinMicroseconds : 0;
+    // 先假设事件足够密集, 从最大窗口开始, 再根据实际的到达间隔收缩
+    spinWindowUs_.store(busyPollMaxUs_, std::memory_order_relaxed);
+    arrivalGapUs_ = busyPollMaxUs_ / 2;
+    lastArrival_ = Timestamp::monotonicNow();
+}
+
+bool EventLoop::spinPoll()
+{
+    Timestamp start = Timestamp::monotonicNow();
+    int64_t window = spinWindowUs_.load(std::memory_order_relaxed);
+    while (!quit_)
+    {
+        pollReturnTime_ = poller_->poll(0, &activeChannels_);
+        if (!activeChannels_.empty() || !pendingFunctors_.empty())
+        {
+            spinHitCount_.fetch_add(1, std::memory_order_relaxed);
+            updateSpinWindow(Timestamp::monotonicNow());
+            return true;
+        }
+        if (Timestamp::monotonicNow().microSecondsSinceEpoch() - start.microSecondsSinceEpoch() >= window)
+        {
+            break;
+        }
+    }
+    return quit_;
+}
+
+void EventLoop::updateSpinWindow(Timestamp arrival)
+{
+    int64_t gap = arrival.microSecondsSinceEpoch() - lastArrival_.microSecondsSinceEpoch();
+    lastArrival_ = arrival;
+    // 滑动平均, 新样本权重 1/8
+    arrivalGapUs_ += (gap - arrivalGapUs_) / 8;
+
+    // 自旋窗口取平均间隔的2倍: 大概率能在窗口内等到下一个事件。
+    // 间隔超过上限说明事件很稀疏, 自旋只会白白消耗CPU, 干脆不自旋。
+    int64_t window = 0;
+    if (arrivalGapUs_ <= busyPollMaxUs_)
+    {
+        window = std::min(arrivalGapUs_ * 2, busyPollMaxUs_);
+        window = std::max<int64_t>(window, 1);
+    }
+    spinWindowUs_.store(window, std::memory_order_relaxed);
+}
+
 /**
  * @brief 请求退出事件循环
  *
@@ -127,7 +244,7 @@ void EventLoop::runInLoop(Functor cb)
     }
     else // 在非当前线程的loop中执行cb，就需要唤醒loop所在线程，执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
@@ -141,39 +258,79 @@ void EventLoop::runInLoop(Functor cb)
  *
  * @param cb 需要在IO线程中执行的回调任务(一个std::function<void()>对象)。
  * @note
- * 1. 此函数是完全线程安全的, 内部使用了互斥锁来保护任务队列。
- * 2. 它包含了精妙的唤醒逻辑, 以确保IO线程能及时处理新加入的任务, 而不是要等到poll超时。
+ * 1. 此函数是完全线程安全的, 任务队列是无锁的MPSC队列, 多个线程同时投递任务时不会互相阻塞。
+ * 2. 只有IO线程阻塞在poll()中时才会唤醒它(见 wakeupIfParked), 避免IO线程忙碌时每个任务都多一次 write/read 系统调用。
  */
 void EventLoop::queueInLoop(Functor cb)
 {
-    // 使用一个代码块来限定锁的作用域, 这是一个很好的RAII实践。
-    // 当 lock 对象离开这个作用域时, 它会自动析构, 从而自动释放互斥锁。
-    // 这大大减小了互斥锁的持有时间。
+    // 入队只需要一次原子exchange, 节点来自回收池, 稳定运行后没有内存分配
+    pendingFunctors_.push(std::move(cb)); // 使用std::move避免不必要的拷贝
+    queuedTaskCount_.fetch_add(1, std::memory_order_relaxed);
+
+    // 唤醒相应的、需要执行上面回调操作的loop线程。
+    // IO线程自己投递的任务(例如在一个待办任务A中又添加了一个新的待办任务B)不需要唤醒:
+    // loop() 在下一次进入 poll() 之前会检查队列, 发现非空就以0超时轮询, 任务B仍会被及时执行。
+    wakeupIfParked();
+}
+
+void EventLoop::queueInLoopBatch(Functor *cbs, size_t count)
+{
+    if (count == 0)
     {
-        // 使用 std::unique_lock 自动管理互斥锁 mutex_ 的生命周期。
-        std::unique_lock<std::mutex> lock(mutex_);
-        // 将任务添加到待办任务队列 pendingFunctors_ 的末尾。
-        // emplace_back 通常比 push_back 更高效, 因为它可以在vector内部直接构造对象。
-        pendingFunctors_.emplace_back(std::move(cb)); // 使用std::move避免不必要的拷贝
+        return;
     }
+    pendingFunctors_.push(cbs, count);
+    queuedTaskCount_.fetch_add(count, std::memory_order_relaxed);
+    // 整批任务最多只触发一次唤醒
+    wakeupIfParked();
+}
 
-    // 唤醒相应的、需要执行上面回调操作的loop线程。
-    // 这里的 if 判断非常关键, 包含了两种需要唤醒的场景:
-    // 1. !isInLoopThread(): 如果是其他线程在调用 queueInLoop, 那么目标IO线程很可能正阻塞在
-    //    Poller::poll() 上, 必须通过 wakeup() 来唤醒它, 否则任务将无法被及时处理。
-    // 2. callingPendingFunctors_: 如果是IO线程自己调用 queueInLoop (例如在一个待办任务A中又添加了
-    //    一个新的待办任务B), 此时IO线程虽然是醒着的, 但它正在处理当前轮次的任务列表。
-    //    如果不唤醒, 新加入的任务B就要等到下一次poll超时或IO事件才能被执行。
-    //    通过wakeup(), 能让poll()在这一轮任务执行完后立即返回, 从而使下一轮循环马上开始,
-    //    确保了任务B的及时执行。
-    if (!isInLoopThread() || callingPendingFunctors_)
+/**
+ * @brief 只在IO线程阻塞于 poll() 时才唤醒它。
+ * @details
+ * IO线程正在处理事件或任务时, 它在进入下一次 poll() 之前一定会重新检查任务队列,
+ * 这时写 eventfd 只会白白多出一次 write 和一次 read 系统调用。
+ * 多个生产者同时发现 parked_ 时, 只有 exchange 成功的那一个会真正调用 wakeup()。
+ */
+void EventLoop::wakeupIfParked()
+{
+    if (isInLoopThread())
+    {
+        return;
+    }
+    // 与 loop() 中的屏障配对, 保证入队操作先于对 parked_ 的检查
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_relaxed) && parked_.exchange(false, std::memory_order_relaxed))
     {
         wakeup(); // "按响门铃", 唤醒IO线程
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 void EventLoop::wakeup()
 {
+    wakeupCount_.fetch_add(1, std::memory_order_relaxed);
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof one);
     if(n!=sizeof one)
@@ -214,35 +371,29 @@ bool EventLoop::hasChannel(Channel *channel)
  *
  * @note
  * 1. 此函数不是线程安全的, 它必须且仅能在其所属的IO线程中被调用。
- * 2. 它使用了一个非常巧妙的 swap 技巧, 将待办任务转移到局部变量中,
- * 这极大地减小了互斥锁的锁定时间, 提高了并发性能。其他线程在IO线程处理
- * 任务时, 仍然可以顺畅地向任务队列中添加新任务。
+ * 2. 先把队列中当前所有的任务取出到 runningFunctors_ 中再逐个执行,
+ * 这与原先 swap 的语义一致: 任务执行过程中新投递的任务留到下一轮循环,
+ * 避免一个不断重新投递自己的任务饿死I/O事件。
  */
 void EventLoop::doPendingFunctors()
 {
-    // 创建一个局部的functor列表, 用于和成员变量 pendingFunctors_ 进行交换。
-    std::vector<Functor> functors;
-
     // 设置标志位为true, 表明当前IO线程正在处理待办任务。
     // 这个标志位用于 queueInLoop 中的唤醒逻辑判断。
     callingPendingFunctors_ = true;
 
-    // 再次使用代码块来最小化锁的作用域
+    // 出队不需要任何锁, 生产者在此期间可以继续无阻塞地投递新任务
+    Functor functor;
+    while (pendingFunctors_.pop(&functor))
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        // 核心技巧: swap。这是一个非常快速的操作(O(1)时间复杂度), 
-        // 它只是交换了两个vector的内部指针等数据, 而不是逐个拷贝元素。
-        // 交换后, pendingFunctors_变为空, 可以立即释放锁, 
-        // 让其他线程可以无阻塞地继续调用 queueInLoop 添加新任务。
-        functors.swap(pendingFunctors_);
+        runningFunctors_.push_back(std::move(functor));
     }
 
-    // 在锁已经释放的情况下, 安全地遍历并执行局部列表中的所有任务。
-    // 这确保了即使某个回调任务执行时间很长, 也不会长时间地阻塞其他线程。
-    for (const Functor &functor : functors)
+    for (const Functor &f : runningFunctors_)
     {
-        functor(); // 执行回调操作
+        f(); // 执行回调操作
     }
+    // clear 保留了 vector 的容量, 下一轮循环可以直接复用
+    runningFunctors_.clear();
 
     // 任务处理完毕, 重置标志位。
     callingPendingFunctors_ = false;
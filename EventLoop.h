@@ -4,15 +4,20 @@
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "InplaceFunction.h"
+#include "Poller.h"
 
 // 前置声明, 避免在头文件中引入完整的类定义, 降低耦合度
 class Channel;
-class Poller;
+class TimerQueue;
+class IoUringPoller;
 
 /**
  * @brief EventLoop 是事件循环的核心类, 它是 Reactor 模式的“反应堆”。
@@ -25,14 +30,17 @@ class EventLoop : noncopyable
 public:
     /**
      * @brief 定义了一个通用的函数对象类型 Functor, 用于跨线程任务的回调。
+     * @details 使用只能移动的 InplaceFunction 而不是 std::function,
+     * 不超过56字节的捕获(例如 [this, std::string])直接存放在对象内部, 投递任务时没有堆分配。
      */
-    using Functor = std::function<void()>;
+    using Functor = InplaceFunction<void()>;
     
     /**
      * @brief 构造函数。
+     * @param backend 使用的IO复用后端, 默认由环境变量 MUDUO_USE_IOURING 决定。
      * @note 会记录当前线程ID, 并初始化Poller和用于线程唤醒的eventfd。
      */
-    EventLoop();
+    explicit EventLoop(Poller::Backend backend = Poller::kDefaultBackend);
 
     /**
      * @brief 析构函数。
@@ -60,6 +68,16 @@ public:
      */
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    /**
+     * @brief 获取本 loop 缓存的“当前时间”。
+     * @details
+     * 该时间在每次 Poller::poll() 返回时刷新一次, 同一轮循环中的所有事件回调
+     * 和日志都可以直接读取它, 而不必每次都去取系统时间。
+     * 在回调中用 Timestamp::now() 减去它, 即可得到事件从 epoll_wait 返回到被处理的排队延迟。
+     * @note 只能在所属的IO线程中调用; loop() 开始之前返回无效的时间戳。
+     */
+    Timestamp cachedNow() const { return pollReturnTime_; }
+
     /**
      * @brief 在当前EventLoop的线程中执行一个任务。
      * * 如果调用此函数的线程就是EventLoop所属的IO线程, 则同步立即执行该任务。
@@ -77,10 +95,132 @@ public:
      */
     void queueInLoop(Functor cb);
 
+    /**
+     * @brief 批量地将 count 个任务放入任务队列。
+     * @details 所有任务用一次原子操作入队, 并且最多只唤醒IO线程一次,
+     * 适合业务线程一次性投递大量回包等场景。
+     * @param cbs 任务数组的起始地址, 其中的任务会被移走。
+     * @param count 任务个数。
+     * @note 线程安全。
+     */
+    void queueInLoopBatch(Functor *cbs, size_t count);
+    void queueInLoopBatch(std::vector<Functor> &cbs) { queueInLoopBatch(cbs.data(), cbs.size()); }
+
+    /// @brief 其他线程实际调用 wakeup() 的次数, 用于和 queuedTaskCount() 对比唤醒的节省情况。
+    uint64_t wakeupCount() const { return wakeupCount_.load(std::memory_order_relaxed); }
+    /// @brief 通过 queueInLoop/queueInLoopBatch 投递的任务总数。
+    uint64_t queuedTaskCount() const { return queuedTaskCount_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 开启或关闭自适应忙轮询。
+     * @details
+     * 开启后, 每轮循环先用 timeout=0 反复 poll(), 直到发现事件或任务、或者自旋时间超过
+     * 当前的自旋窗口, 才退回到阻塞的 poll()。这样事件到来时不需要经过“睡眠-唤醒”的路径。
+     * 自旋窗口根据观察到的事件到达间隔(指数滑动平均)自动调整为间隔的2倍, 最大为 maxSpinMicroseconds;
+     * 事件稀疏到间隔超过上限时窗口变为0, 不再空转, 事件重新变密集时再恢复。
+     * @param maxSpinMicroseconds 自旋窗口的上限(微秒), 0 表示关闭忙轮询。
+     * @note 必须在 loop() 之前或在IO线程中调用。
+     */
+    void setBusyPoll(int maxSpinMicroseconds);
+
+    /// @brief 在自旋阶段就发现了事件或任务的次数。
+    uint64_t spinHitCount() const { return spinHitCount_.load(std::memory_order_relaxed); }
+    /// @brief 自旋没有等到事件、退回阻塞 poll() 的次数。
+    uint64_t blockingWaitCount() const { return blockingWaitCount_.load(std::memory_order_relaxed); }
+    /// @brief 当前的自旋窗口(微秒)。
+    int64_t spinWindowMicroseconds() const { return spinWindowUs_.load(std::memory_order_relaxed); }
+
+    /// @brief 读临时区的大小
+    static const size_t kReadArenaSize = 64 * 1024;
+
+    /**
+     * @brief 本 loop 上所有连接共用的读临时区, 大小为 kReadArenaSize, 第一次使用时分配。
+     * @details 连接读数据时, 可写空间放不下的部分先读到这里再追加到 Buffer,
+     * 同一时刻只有一个连接在读, 所以一块就够了, 不必每次读取都在栈上准备 64K。
+     * @note 只能在IO线程中使用, 并且不能跨回调保存。
+     */
+    char *readArena();
+
+    /**
+     * @brief 记录一次读取的字节数和使用的 read 系统调用次数。
+     * @note 只能在IO线程中调用。
+     */
+    void recordRead(size_t bytes, int syscalls)
+    {
+        readBytes_.store(readBytes_.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        readSyscallCount_.store(readSyscallCount_.load(std::memory_order_relaxed) + syscalls, std::memory_order_relaxed);
+    }
+
+    /// @brief 本 loop 上读取的总字节数。
+    uint64_t readBytes() const { return readBytes_.load(std::memory_order_relaxed); }
+    /// @brief 本 loop 上 read 系统调用的总次数。
+    uint64_t readSyscallCount() const { return readSyscallCount_.load(std::memory_order_relaxed); }
+    /// @brief 平均每次 read 系统调用读取的字节数。
+    double bytesPerReadSyscall() const
+    {
+        uint64_t calls = readSyscallCount();
+        return calls == 0 ? 0.0 : static_cast<double>(readBytes()) / calls;
+    }
+
+    /**
+     * @brief 累加本 loop 上连接缓冲数据量的变化, 由 TcpConnection 调用。
+     * @note 只能在IO线程中调用。
+     */
+    void addBufferedBytes(int64_t delta)
+    {
+        bufferedBytes_.store(bufferedBytes_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    /// @brief 本 loop 上所有连接当前缓冲的字节数(输入缓冲区 + 待发送数据), 可以在任意线程中读取。
+    size_t bufferedBytes() const
+    {
+        int64_t bytes = bufferedBytes_.load(std::memory_order_relaxed);
+        return bytes > 0 ? static_cast<size_t>(bytes) : 0;
+    }
+
+    /**
+     * @brief 增减分配到本 loop 的连接数, 由 TcpConnection 的构造函数和析构函数调用。
+     * @note 线程安全, 连接在 accept 所在的线程中创建、在IO线程中销毁。
+     */
+    void addConnections(int delta) { numConnections_.fetch_add(delta, std::memory_order_relaxed); }
+    /// @brief 分配到本 loop 的连接数, 可以在任意线程中读取, 供 LoopSelector 使用。
+    size_t numConnections() const
+    {
+        int64_t n = numConnections_.load(std::memory_order_relaxed);
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+
+    /**
+     * @brief 在指定的时间点执行一次回调。
+     * @param time 到期时间。
+     * @param cb 到期后在IO线程中执行的回调。
+     * @return TimerId 可用于 cancel() 的定时器句柄。
+     * @note 线程安全, 可以在任意线程中调用。
+     */
+    TimerId runAt(Timestamp time, TimerCallback cb);
+
+    /**
+     * @brief 在 delay 秒之后执行一次回调。
+     * @note 线程安全, 可以在任意线程中调用。
+     */
+    TimerId runAfter(double delay, TimerCallback cb);
+
+    /**
+     * @brief 每隔 interval 秒执行一次回调, 直到被 cancel()。
+     * @note 线程安全, 可以在任意线程中调用。
+     */
+    TimerId runEvery(double interval, TimerCallback cb);
+
+    /**
+     * @brief 取消一个定时器。
+     * @param timerId runAt/runAfter/runEvery 返回的定时器句柄。
+     * @note 线程安全, 可以在任意线程中调用。取消一个已经执行完毕的一次性定时器是无害的。
+     */
+    void cancel(TimerId timerId);
+
     /**
      * @brief 唤醒当前EventLoop所在的IO线程。
      * * 主要由其他线程在向任务队列放入新任务后调用, 用于唤醒可能阻塞在poll()的IO线程。
-     * @note 其底层实现是向 wakeupFd_ 写入一个字节。
+     * @note 其底层实现是向 wakeupFd_ 写入8个字节。
      */
     void wakeup();
 
@@ -112,6 +252,21 @@ public:
      */
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
+    /**
+     * @brief 获取当前线程所拥有的 EventLoop。
+     * @return EventLoop* 当前线程不是IO线程时返回 nullptr。
+     */
+    static EventLoop *getEventLoopOfCurrentThread();
+
+    /**
+     * @brief 获取 io_uring 后端, 用于提交异步收发操作。
+     * @return IoUringPoller* 当前 loop 使用的不是 io_uring 时返回 nullptr。
+     */
+    IoUringPoller *ioUringPoller() const { return ioUringPoller_; }
+
+    /// @brief 当前的 Poller 是否支持边缘触发的 Channel。
+    bool edgeTriggeredSupported() const { return poller_->edgeTriggeredSupported(); }
+
 private:
     /**
      * @brief 用于处理 wakeupFd_ 上的可读事件的回调函数。
@@ -126,8 +281,24 @@ private:
      */
     void doPendingFunctors();
 
+    /**
+     * @brief 任务入队之后调用, 只在IO线程“从休眠转为忙碌”时才真正唤醒它。
+     */
+    void wakeupIfParked();
+
+    /**
+     * @brief 忙轮询的自旋阶段: 在自旋窗口内反复调用 poll(0)。
+     * @return bool 是否等到了事件或任务。
+     */
+    bool spinPoll();
+
+    /**
+     * @brief 根据本轮事件到达的时间更新到达间隔的滑动平均, 并重新计算自旋窗口。
+     */
+    void updateSpinWindow(Timestamp arrival);
+
     /// @brief 定义了Channel指针的列表类型
-    using ChannelList = std::vector<Channel *>;
+    using ChannelList = Poller::ChannelList;
 
     /// @brief 原子布尔值, 标识事件循环是否正在运行 (looping_为true)。
     std::atomic_bool looping_;
@@ -140,19 +311,48 @@ private:
     Timestamp pollReturnTime_;
     /// @brief EventLoop拥有的Poller子系统 (采用unique_ptr管理其生命周期)。
     std::unique_ptr<Poller> poller_;
+    /// @brief poller_ 是 IoUringPoller 时指向它, 否则为 nullptr
+    IoUringPoller *ioUringPoller_;
 
     /// @brief 用于唤醒的eventfd。其他线程通过向此fd写入8字节数据来唤醒当前线程的poll阻塞。
     int wakeupFd_;
     /// @brief 封装了wakeupFd_的Channel, 专门用于监听来自其他线程的唤醒事件。
     std::unique_ptr<Channel> wakeupChannel_;
+    /// @brief 定时器队列, 由timerfd驱动, 必须在poller_之后构造、之前析构。
+    std::unique_ptr<TimerQueue> timerQueue_;
 
     /// @brief Poller返回的当前活跃的Channel列表。
     ChannelList activeChannels_;
 
     /// @brief 原子布尔值, 标识当前是否正在执行任务队列中的回调。用于防止在处理回调时再次向队列添加任务的递归情况。
     std::atomic_bool callingPendingFunctors_;
-    /// @brief 存储了其他线程请求在此IO线程中执行的回调函数任务队列。
-    std::vector<Functor> pendingFunctors_;
-    /// @brief 用于保护pendingFunctors_任务队列的互斥锁, 保证其在多线程环境下的添加操作是安全的。
-    std::mutex mutex_;
+    /// @brief IO线程即将或正在阻塞在 poll() 中。只有这时投递任务才需要 wakeup(), 由第一个发现它的生产者清除。
+    std::atomic_bool parked_;
+    /// @brief wakeup() 被调用的次数
+    std::atomic<uint64_t> wakeupCount_;
+    /// @brief 投递的任务总数
+    std::atomic<uint64_t> queuedTaskCount_;
+    /// @brief 忙轮询的自旋窗口上限(微秒), 0 表示关闭
+    int64_t busyPollMaxUs_;
+    /// @brief 当前的自旋窗口(微秒)
+    std::atomic<int64_t> spinWindowUs_;
+    /// @brief 事件到达间隔的滑动平均(微秒)
+    int64_t arrivalGapUs_;
+    /// @brief 上一次有事件到达的时间(单调时钟)
+    Timestamp lastArrival_;
+    std::atomic<uint64_t> spinHitCount_;
+    std::atomic<uint64_t> blockingWaitCount_;
+    /// @brief 读临时区, 见 readArena()
+    std::unique_ptr<char[]> readArena_;
+    /// @brief 读取统计, 只由IO线程写入, 原子类型只是为了其他线程可以读取
+    std::atomic<uint64_t> readBytes_;
+    std::atomic<uint64_t> readSyscallCount_;
+    /// @brief 本 loop 上的连接当前缓冲的字节数, 只由IO线程写入
+    std::atomic<int64_t> bufferedBytes_;
+    /// @brief 分配到本 loop 的连接数
+    std::atomic<int64_t> numConnections_;
+    /// @brief 存储了其他线程请求在此IO线程中执行的回调函数任务队列。无锁的多生产者单消费者队列, 本线程是唯一的消费者。
+    MpscQueue<Functor> pendingFunctors_;
+    /// @brief doPendingFunctors() 使用的临时列表, 作为成员复用以避免每轮循环都分配内存。
+    std::vector<Functor> runningFunctors_;
 };
\ No newline at end of file
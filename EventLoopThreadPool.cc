@@ -36,11 +36,15 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     }
 }
 
-EventLoop *EventLoopThreadPool::getNextLoop()
+EventLoop *EventLoopThreadPool::getNextLoop(const InetAddress *peerAddr)
 {
     EventLoop *loop = baseLoop_;
 
-    if (!loops_.empty())
+    if (!loops_.empty() && selector_)
+    {
+        loop = selector_->select(loops_, peerAddr);
+    }
+    else if (!loops_.empty())
     {
         loop = loops_[next_]; // 通过轮询获得处理下一个事件的loop
         ++next_;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "LoopSelector.h"
 
 #include <functional>
 #include <string>
@@ -8,6 +9,7 @@
 #include <vector>
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
@@ -21,7 +23,11 @@ public:
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
     // 如果工作在多线程中，baseLoop_默认轮询方式分配channel给subLoop
-    EventLoop *getNextLoop();
+    // 设置了 LoopSelector 时由它选择, peerAddr 是新连接的对端地址(可以为空)
+    EventLoop *getNextLoop(const InetAddress *peerAddr = nullptr);
+
+    // 设置选择subLoop的策略, 为空时恢复轮询。只能在baseLoop线程中调用
+    void setLoopSelector(std::unique_ptr<LoopSelector> selector) { selector_ = std::move(selector); }
 
     std::vector<EventLoop *> getAllLoops();
 
@@ -36,4 +42,5 @@ private:
     int next_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop *> loops_;
+    std::unique_ptr<LoopSelector> selector_;
 };
\ No newline at end of file
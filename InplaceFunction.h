@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/// @brief InplaceFunction 默认的内联存储大小。存储按指针对齐, 加上一个指针后整个对象是 64 字节(一个缓存行的大小)。
+static const size_t kDefaultInplaceCapacity = 56;
+
+template <typename Signature, size_t Capacity = kDefaultInplaceCapacity>
+class InplaceFunction;
+
+/**
+ * @brief 只能移动、带小对象优化的可调用对象包装器, 用于替换热路径上的 std::function。
+ * @details
+ * std::function 要求目标可拷贝, 并且 libstdc++ 只为不超过16字节的目标提供内联存储,
+ * 像 [this, buf] 这样捕获了一个 std::string 的 lambda 每次构造都要分配一次堆内存。
+ * InplaceFunction 把不超过 Capacity 字节、且可以无异常移动的目标直接放在对象内部,
+ * 只有更大的目标才退化为堆分配; 它本身不可拷贝, 因此也可以保存只能移动的 lambda。
+ * 调用语义与 std::function 一致: operator() 是 const 的, 但目标以非 const 方式调用。
+ * 内联存储按指针对齐, 对齐要求超过指针的目标(例如包含 long double)保存在堆上。
+ * @tparam Capacity 内联存储的字节数。
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+public:
+    InplaceFunction() noexcept : ops_(nullptr) {}
+    InplaceFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename Fn = typename std::decay<F>::type,
+              typename = typename std::enable_if<!std::is_same<Fn, InplaceFunction>::value>::type>
+    InplaceFunction(F &&f)
+        : ops_(nullptr)
+    {
+        if (isEmpty(f))
+        {
+            return;
+        }
+        if constexpr (kStoredInline<Fn>)
+        {
+            new (&storage_) Fn(std::forward<F>(f));
+            ops_ = &InlineOps<Fn>::kOps;
+        }
+        else
+        {
+            *reinterpret_cast<Fn **>(&storage_) = new Fn(std::forward<F>(f));
+            ops_ = &HeapOps<Fn>::kOps;
+        }
+    }
+
+    InplaceFunction(InplaceFunction &&other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_ != nullptr)
+        {
+            ops_->relocate(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InplaceFunction &operator=(InplaceFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_ != nullptr)
+            {
+                other.ops_->relocate(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction &) = delete;
+    InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+    ~InplaceFunction() { reset(); }
+
+    R operator()(Args... args) const
+    {
+        if (ops_ == nullptr)
+        {
+            throw std::bad_function_call();
+        }
+        return ops_->invoke(const_cast<Storage *>(&storage_), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    /// @brief 目标对象是否保存在内联存储中(没有堆分配), 主要用于测试和压测。
+    bool storedInline() const noexcept { return ops_ != nullptr && ops_->isInline; }
+
+private:
+    // 按指针而不是 max_align_t 对齐, 否则存储会被补齐到16的倍数, 对象多出一个指针之外的填充
+    using Storage = typename std::aligned_storage<Capacity, alignof(void *)>::type;
+
+    /// @brief 类型擦除后的操作表, 每种目标类型一份静态实例
+    struct Ops
+    {
+        R (*invoke)(Storage *storage, Args &&...args);
+        /// @brief 把 src 中的目标移动到 dst, 并销毁 src 中的目标
+        void (*relocate)(Storage *dst, Storage *src);
+        void (*destroy)(Storage *storage);
+        bool isInline;
+    };
+
+    template <typename Fn>
+    static constexpr bool kStoredInline = sizeof(Fn) <= Capacity &&
+                                          alignof(Fn) <= alignof(void *) &&
+                                          std::is_nothrow_move_constructible<Fn>::value;
+
+    template <typename Fn>
+    struct InlineOps
+    {
+        static Fn *get(Storage *storage) { return std::launder(reinterpret_cast<Fn *>(storage)); }
+
+        static R invoke(Storage *storage, Args &&...args) { return (*get(storage))(std::forward<Args>(args)...); }
+
+        static void relocate(Storage *dst, Storage *src)
+        {
+            new (dst) Fn(std::move(*get(src)));
+            get(src)->~Fn();
+        }
+
+        static void destroy(Storage *storage) { get(storage)->~Fn(); }
+
+        static constexpr Ops kOps = {&invoke, &relocate, &destroy, true};
+    };
+
+    template <typename Fn>
+    struct HeapOps
+    {
+        static Fn *&get(Storage *storage) { return *reinterpret_cast<Fn **>(storage); }
+
+        static R invoke(Storage *storage, Args &&...args) { return (*get(storage))(std::forward<Args>(args)...); }
+
+        static void relocate(Storage *dst, Storage *src) { *reinterpret_cast<Fn **>(dst) = get(src); }
+
+        static void destroy(Storage *storage) { delete get(storage); }
+
+        static constexpr Ops kOps = {&invoke, &relocate, &destroy, false};
+    };
+
+    // 空的函数指针或 std::function 构造出来的也是空对象, 与 std::function 的行为一致
+    template <typename F>
+    static bool isEmpty(const F &) { return false; }
+    template <typename T>
+    static bool isEmpty(T *f) { return f == nullptr; }
+    template <typename Sig>
+    static bool isEmpty(const std::function<Sig> &f) { return !f; }
+
+    void reset() noexcept
+    {
+        if (ops_ != nullptr)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops *ops_;
+};
+
+static_assert(sizeof(InplaceFunction<void()>) == 64, "default InplaceFunction should be one cache line");
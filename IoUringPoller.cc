@@ -0,0 +1,534 @@
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+// Channel未添加到Poller中
+static const int kNew = -1;
+// Channel已添加到Poller中
+static const int kAdded = 1;
+// Channel从Poller中删除
+static const int kDeleted = 2;
+
+// user_data 的最高两位区分完成事件的种类
+static const uint64_t kTypeMask = 3ULL << 62;
+static const uint64_t kPollTag = 0;                // 低32位是fd, 中间30位是注册序号
+static const uint64_t kOperationTag = 1ULL << 62;  // 低62位是 Operation 指针
+static const uint64_t kInternalTag = 2ULL << 62;   // 超时、撤销等内部请求, 完成事件直接忽略
+static const uint32_t kSeqMask = 0x3FFFFFFF;
+
+static inline uint64_t encodePoll(int fd, uint32_t seq)
+{
+    return (static_cast<uint64_t>(seq & kSeqMask) << 32) | static_cast<uint32_t>(fd);
+}
+
+static int sysIoUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int sysIoUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int sysIoUringRegister(int ringFd, unsigned opcode, void *arg, unsigned nrArgs)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs));
+}
+
+// 探测内核是否支持本实现用到的全部操作码
+static bool probeIoUring()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    int ringFd = sysIoUringSetup(4, &params);
+    if (ringFd < 0)
+    {
+        return false;
+    }
+
+    bool supported = (params.features & IORING_FEAT_NODROP) != 0;
+    if (supported)
+    {
+        const unsigned kProbeOps = 256;
+        std::vector<char> probeBuf(sizeof(struct io_uring_probe) + kProbeOps * sizeof(struct io_uring_probe_op), 0);
+        struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(probeBuf.data());
+        if (sysIoUringRegister(ringFd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0)
+        {
+            supported = false;
+        }
+        else
+        {
+            const int required[] = {IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_TIMEOUT,
+                                    IORING_OP_ASYNC_CANCEL, IORING_OP_RECV, IORING_OP_SEND};
+            for (int op : required)
+            {
+                if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                {
+                    supported = false;
+                    break;
+                }
+            }
+        }
+    }
+    ::close(ringFd);
+    return supported;
+}
+
+bool IoUringPoller::isSupported()
+{
+    static const bool supported = probeIoUring();
+    return supported;
+}
+
+/**
+ * @brief IoUringPoller 构造函数, 创建 ring 并映射提交队列和完成队列
+ * @param loop 所属的 EventLoop
+ */
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop),
+      ringFd_(-1),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      sqes_(nullptr),
+      sqesSize_(0),
+      sqLocalTail_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      nextSeq_(1)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    ringFd_ = sysIoUringSetup(kRingEntries, &params);
+    if (ringFd_ < 0)
+    {
+        LOG_FATAL("io_uring_setup error:%d \n", errno);
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        LOG_FATAL("io_uring mmap sq ring error:%d \n", errno);
+    }
+    if (singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            LOG_FATAL("io_uring mmap cq ring error:%d \n", errno);
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG_FATAL("io_uring mmap sqes error:%d \n", errno);
+    }
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqLocalTail_ = *sqTail_;
+
+    char *cq = static_cast<char *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    operations_.prev = &operations_;
+    operations_.next = &operations_;
+    memset(&timeout_, 0, sizeof timeout_);
+}
+
+/**
+ * @brief IoUringPoller 析构函数, 等待所有未完成的异步操作结束后再释放 ring
+ * @details
+ * close(ringFd_) 并不会立即释放 ring(共享内存的映射仍然持有它), 即使最终释放时内核也是异步地撤销请求,
+ * 在此之前内核仍可能写入接收缓冲区。所以必须先撤销并收割所有操作, 然后才能解除映射和关闭。
+ * 正常情况下 EventLoop 析构时已经调用过 cancelAllOperations(), 这里只是兜底。
+ */
+IoUringPoller::~IoUringPoller()
+{
+    cancelAllOperations();
+    if (operations_.next != &operations_)
+    {
+        // 收割失败, 内核可能还持有缓冲区的地址, 宁可泄漏这些操作也不能释放它们
+        LOG_ERROR("IoUringPoller::~IoUringPoller leaking unfinished operations\n");
+    }
+    ::munmap(sqes_, sqesSize_);
+    if (cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    ::munmap(sqRing_, sqRingSize_);
+    ::close(ringFd_);
+}
+
+/**
+ * @brief 重新提交上一轮已触发的 POLL_ADD, 然后用一次 io_uring_enter 提交所有请求并等待完成事件
+ * @param timeoutMs 超时时间（毫秒）, 0 表示不等待
+ * @param activeChannels 输出参数，用于存储活跃的 Channel
+ * @return 事件发生的时间戳
+ */
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_DEBUG("func=%s => fd total count: %lu\n", __FUNCTION__, numChannels_);
+
+    for (int fd : rearmList_)
+    {
+        auto it = registrations_.find(fd);
+        if (it == registrations_.end())
+        {
+            continue;
+        }
+        Registration &reg = it->second;
+        reg.rearmQueued = false;
+        if (!reg.armed && !reg.channel->isNoneEvent())
+        {
+            arm(fd, reg);
+        }
+    }
+    rearmList_.clear();
+
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned waitNr = 0;
+    // 完成队列中已经有事件时不需要等待
+    if (timeoutMs != 0 && head == tail)
+    {
+        waitNr = 1;
+        if (timeoutMs > 0)
+        {
+            // off=1: 只要有任何一个其他完成事件到来, 这个超时请求就会随之完成, 不会残留到下一轮
+            timeout_.tv_sec = timeoutMs / 1000;
+            timeout_.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            struct io_uring_sqe *sqe = getSqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<uint64_t>(&timeout_);
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = kInternalTag;
+        }
+    }
+
+    int ret = submitAndWait(waitNr);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    if (ret < 0 && saveErrno != EINTR && saveErrno != ETIME)
+    {
+        errno = saveErrno;
+        LOG_ERROR("IoUringPoller::poll() error:%d", saveErrno);
+    }
+
+    head = *cqHead_;
+    tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    int numEvents = 0;
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &cqes_[head & cqMask_];
+        uint64_t userData = cqe->user_data;
+        int res = cqe->res;
+        ++head;
+
+        uint64_t type = userData & kTypeMask;
+        if (type == kOperationTag)
+        {
+            Operation *op = reinterpret_cast<Operation *>(userData & ~kTypeMask);
+            completedOperations_.push_back(std::make_pair(op, res));
+        }
+        else if (type == kPollTag)
+        {
+            int fd = static_cast<int>(userData & 0xFFFFFFFF);
+            uint32_t seq = static_cast<uint32_t>(userData >> 32) & kSeqMask;
+            auto it = registrations_.find(fd);
+            // 注册序号不一致说明这个事件属于一个已经撤销或修改过的请求, 直接丢弃
+            if (it == registrations_.end() || it->second.seq != seq || res == -ECANCELED)
+            {
+                continue;
+            }
+            Registration &reg = it->second;
+            reg.armed = false;
+            reg.channel->set_revents(res < 0 ? static_cast<int>(EPOLLERR) : res);
+            activeChannels->push_back(ActiveChannel{reg.channel, fd, generationOf(fd)});
+            queueRearm(fd, reg);
+            ++numEvents;
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    if (numEvents > 0)
+    {
+        LOG_DEBUG("%d events happened \n", numEvents);
+    }
+
+    // 执行异步操作的完成回调。回调中可能提交新的操作, 所以先换出到局部变量
+    std::vector<std::pair<Operation *, int>> completed;
+    completed.swap(completedOperations_);
+    for (auto &item : completed)
+    {
+        Operation *op = item.first;
+        op->prev->next = op->next;
+        op->next->prev = op->prev;
+        CompletionCallback cb(std::move(op->callback));
+        delete op;
+        cb(item.second);
+    }
+
+    return now;
+}
+
+/**
+ * @brief 在 Poller 中更新或添加 Channel
+ * @details 真正的 POLL_ADD 会延迟到下一次 poll() 时和其他请求一起提交
+ * @param channel 需要更新的 Channel
+ */
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd, channel->events(), index);
+
+    if (index == kNew || index == kDeleted)
+    {
+        if (index == kNew)
+        {
+            addChannelSlot(channel);
+            Registration reg;
+            reg.channel = channel;
+            reg.seq = nextSeq_++;
+            reg.armed = false;
+            reg.rearmQueued = false;
+            reg.armedEvents = 0;
+            registrations_[fd] = reg;
+        }
+        channel->set_index(kAdded);
+        queueRearm(fd, registrations_[fd]);
+    }
+    else
+    {
+        Registration &reg = registrations_[fd];
+        if (channel->isNoneEvent())
+        {
+            disarm(fd, reg);
+            channel->set_index(kDeleted);
+        }
+        else if (!reg.armed || reg.armedEvents != channel->events())
+        {
+            // 关心的事件变了, 撤销旧的请求, 下一轮用新的事件重新提交
+            disarm(fd, reg);
+            queueRearm(fd, reg);
+        }
+    }
+}
+
+/**
+ * @brief 从 Poller 中移除 Channel
+ * @param channel 需要移除的 Channel
+ */
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    removeChannelSlot(fd);
+
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+    auto it = registrations_.find(fd);
+    if (it != registrations_.end())
+    {
+        disarm(fd, it->second);
+        registrations_.erase(it);
+    }
+    channel->set_index(kNew);
+}
+
+uint64_t IoUringPoller::submitRecv(int fd, void *buf, size_t len, CompletionCallback cb)
+{
+    return submitOperation(IORING_OP_RECV, fd, buf, len, std::move(cb));
+}
+
+uint64_t IoUringPoller::submitSend(int fd, const void *buf, size_t len, CompletionCallback cb)
+{
+    return submitOperation(IORING_OP_SEND, fd, buf, len, std::move(cb));
+}
+
+void IoUringPoller::cancel(uint64_t operationId)
+{
+    // 操作可能已经完成, 此时内核只会返回 -ENOENT, 并不会访问这个地址
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = operationId;
+    sqe->user_data = kInternalTag;
+}
+
+void IoUringPoller::cancelAllOperations()
+{
+    while (operations_.next != &operations_)
+    {
+        for (Operation *op = operations_.next; op != &operations_; op = op->next)
+        {
+            if (!op->cancelRequested)
+            {
+                op->cancelRequested = true;
+                cancel(kOperationTag | reinterpret_cast<uint64_t>(op));
+            }
+        }
+
+        // 每个撤销请求都会产生完成事件, 因此这里一定能等到
+        int ret = submitAndWait(1);
+        if (ret < 0 && errno != EINTR)
+        {
+            LOG_ERROR("IoUringPoller::cancelAllOperations error:%d\n", errno);
+            return;
+        }
+
+        // 只收割异步操作, 就绪事件已经没有人处理了, 直接丢弃
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            const struct io_uring_cqe *cqe = &cqes_[head & cqMask_];
+            if ((cqe->user_data & kTypeMask) == kOperationTag)
+            {
+                completedOperations_.push_back(
+                    std::make_pair(reinterpret_cast<Operation *>(cqe->user_data & ~kTypeMask), -ECANCELED));
+            }
+            ++head;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+        std::vector<std::pair<Operation *, int>> completed;
+        completed.swap(completedOperations_);
+        for (auto &item : completed)
+        {
+            Operation *op = item.first;
+            op->prev->next = op->next;
+            op->next->prev = op->prev;
+            CompletionCallback cb(std::move(op->callback));
+            delete op;
+            cb(item.second);
+        }
+    }
+}
+
+uint64_t IoUringPoller::submitOperation(int opcode, int fd, const void *buf, size_t len, CompletionCallback cb)
+{
+    Operation *op = new Operation;
+    op->callback = std::move(cb);
+    op->cancelRequested = false;
+    op->prev = operations_.prev;
+    op->next = &operations_;
+    operations_.prev->next = op;
+    operations_.prev = op;
+
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = static_cast<uint8_t>(opcode);
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    if (opcode == IORING_OP_SEND)
+    {
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    sqe->user_data = kOperationTag | reinterpret_cast<uint64_t>(op);
+    return sqe->user_data;
+}
+
+struct io_uring_sqe *IoUringPoller::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqLocalTail_ - head >= sqEntries_)
+    {
+        // 提交队列满了, 先把已有的请求交给内核
+        submitAndWait(0);
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqLocalTail_ - head >= sqEntries_)
+        {
+            LOG_FATAL("IoUringPoller submission queue overflow\n");
+        }
+    }
+    unsigned index = sqLocalTail_ & sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqLocalTail_;
+    return sqe;
+}
+
+int IoUringPoller::submitAndWait(unsigned waitNr)
+{
+    unsigned toSubmit = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0 && waitNr == 0)
+    {
+        return 0;
+    }
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    return sysIoUringEnter(ringFd_, toSubmit, waitNr, flags);
+}
+
+void IoUringPoller::arm(int fd, Registration &reg)
+{
+    reg.seq = nextSeq_++;
+    reg.armed = true;
+    reg.armedEvents = reg.channel->events();
+
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // poll(2) 的事件位与 epoll 的 EPOLLIN/EPOLLOUT/EPOLLPRI 等取值相同
+    sqe->poll32_events = static_cast<uint32_t>(reg.armedEvents);
+    sqe->user_data = encodePoll(fd, reg.seq);
+}
+
+void IoUringPoller::disarm(int fd, Registration &reg)
+{
+    if (!reg.armed)
+    {
+        return;
+    }
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = encodePoll(fd, reg.seq);
+    sqe->user_data = kInternalTag;
+    // 换一个新的序号, 即使旧请求在撤销前已经触发, 它的完成事件也会被丢弃
+    reg.seq = nextSeq_++;
+    reg.armed = false;
+}
+
+void IoUringPoller::queueRearm(int fd, Registration &reg)
+{
+    if (!reg.rearmQueued)
+    {
+        reg.rearmQueued = true;
+        rearmList_.push_back(fd);
+    }
+}
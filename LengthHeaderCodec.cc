@@ -0,0 +1,59 @@
+#include "LengthHeaderCodec.h"
+#include "Buffer.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+#include <string.h>
+#include <endian.h>
+#include <sys/uio.h>
+
+LengthHeaderCodec::LengthHeaderCodec(FrameCallback cb, size_t maxFrameSize)
+    : frameCallback_(std::move(cb)),
+      maxFrameSize_(maxFrameSize)
+{
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    const size_t readable = buf->readableBytes();
+    if (readable < kHeaderLen)
+    {
+        return;
+    }
+
+    // 在可读区域上直接向前移动, 所有完整的帧交付完后再一次性 retrieve
+    const char *data = buf->peek();
+    size_t consumed = 0;
+    while (readable - consumed >= kHeaderLen)
+    {
+        uint32_t be32 = 0;
+        memcpy(&be32, data + consumed, sizeof be32);
+        const int32_t len = static_cast<int32_t>(be32toh(be32));
+        if (len < 0 || static_cast<size_t>(len) > maxFrameSize_)
+        {
+            LOG_ERROR("LengthHeaderCodec: invalid frame length %d from %s, max %zu, closing",
+                      len, conn->name().c_str(), maxFrameSize_);
+            buf->retrieveAll();
+            conn->forceClose();
+            return;
+        }
+        if (readable - consumed - kHeaderLen < static_cast<size_t>(len))
+        {
+            break; // 半包, 等待更多数据
+        }
+        frameCallback_(conn, std::string_view(data + consumed + kHeaderLen, len), receiveTime);
+        consumed += kHeaderLen + len;
+    }
+    buf->retrieve(consumed);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, std::string_view frame)
+{
+    uint32_t be32 = htobe32(static_cast<uint32_t>(frame.size()));
+    struct iovec iov[2];
+    iov[0].iov_base = &be32;
+    iov[0].iov_len = sizeof be32;
+    iov[1].iov_base = const_cast<char *>(frame.data());
+    iov[1].iov_len = frame.size();
+    conn->sendv(iov, 2);
+}
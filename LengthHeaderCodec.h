@@ -0,0 +1,56 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string_view>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 4字节长度头(网络字节序)的分帧编解码器。
+ * @details
+ * 线上格式: | int32 len | len 字节的消息体 |, len 不包含长度头本身。
+ * onMessage() 作为连接的消息回调, 每凑齐一帧就调用一次 FrameCallback,
+ * 传入的是直接指向输入缓冲区内部的只读视图, 不会为每一帧分配 std::string。
+ * 一次读到的所有完整帧都交付之后才统一 retrieve, 输入缓冲区只整理一次。
+ *
+ * 用法:
+ * @code
+ *   LengthHeaderCodec codec([](const TcpConnectionPtr &conn, std::string_view frame, Timestamp) {
+ *       LengthHeaderCodec::send(conn, frame);
+ *   });
+ *   server.setMessageCallback([&codec](const TcpConnectionPtr &conn, Buffer *buf, Timestamp t) {
+ *       codec.onMessage(conn, buf, t);
+ *   });
+ * @endcode
+ * @note frame 只在回调期间有效, 需要保留时调用方自行拷贝。
+ */
+class LengthHeaderCodec : noncopyable
+{
+public:
+    using FrameCallback = std::function<void(const TcpConnectionPtr &, std::string_view, Timestamp)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+    static const size_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+    /**
+     * @param maxFrameSize 允许的最大消息体长度。长度头超过它(或为负数)时认为对端出错,
+     * 直接关闭连接, 这样单个连接的输入缓冲区最多只会积累 kHeaderLen + maxFrameSize 字节。
+     */
+    explicit LengthHeaderCodec(FrameCallback cb, size_t maxFrameSize = kDefaultMaxFrameSize);
+
+    /// @brief 连接的消息回调, 解析并交付 buf 中所有完整的帧
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    /// @brief 加上长度头发送一帧, 长度头和消息体通过 sendv 一起发出, 不需要拼接
+    static void send(const TcpConnectionPtr &conn, std::string_view frame);
+
+    size_t maxFrameSize() const { return maxFrameSize_; }
+
+private:
+    FrameCallback frameCallback_;
+    const size_t maxFrameSize_;
+};
@@ -1,6 +1,7 @@
 #include "Logger.h"
 #include "Timestamp.h"     // 👈 【新增】包含时间戳头文件
 #include "CurrentThread.h" // 👈 【新增】包含当前线程信息头文件
+#include "EventLoop.h"
 #include <iostream>
 #include <cstdarg> // C风格可变参数所需的头文件
 #include <cstdlib>
@@ -34,8 +35,12 @@ void Logger::log(LogLevel level, const char *format, ...)
         return;
     }
 
+    // 在IO线程中优先使用 EventLoop 每轮 poll 返回时缓存的时间, 省去一次取时间的开销
+    EventLoop *loop = EventLoop::getEventLoopOfCurrentThread();
+    Timestamp now = (loop != nullptr && loop->cachedNow().valid()) ? loop->cachedNow() : Timestamp::now();
+
     // 【改造一】构建日志消息的前缀: [时间戳 tid] [日志级别]
-    std::cout << Timestamp::now().toString()     // 输出当前时间
+    std::cout << now.toString()                  // 输出当前时间
               << " tid:" << CurrentThread::tid() // 输出当前线程ID
               << " ";
 
@@ -0,0 +1,173 @@
+#include "LoopSelector.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+
+namespace
+{
+class RoundRobinSelector : public LoopSelector
+{
+public:
+    RoundRobinSelector() : next_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *) override
+    {
+        if (next_ >= loops.size())
+        {
+            next_ = 0;
+        }
+        return loops[next_++];
+    }
+
+private:
+    size_t next_;
+};
+
+/**
+ * @brief 取负载最小的 loop。
+ * @details 每次从不同的位置开始扫描, 负载相同时(例如刚启动时都为0)不会总是选中第一个 loop。
+ */
+class LeastLoadSelector : public LoopSelector
+{
+public:
+    explicit LeastLoadSelector(bool byBytes) : byBytes_(byBytes), start_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *) override
+    {
+        size_t n = loops.size();
+        if (++start_ >= n)
+        {
+            start_ = 0;
+        }
+        EventLoop *best = loops[start_];
+        size_t bestLoad = load(best);
+        for (size_t i = 1; i < n && bestLoad > 0; ++i)
+        {
+            EventLoop *loop = loops[(start_ + i) % n];
+            size_t l = load(loop);
+            if (l < bestLoad)
+            {
+                best = loop;
+                bestLoad = l;
+            }
+        }
+        return best;
+    }
+
+private:
+    size_t load(EventLoop *loop) const
+    {
+        return byBytes_ ? loop->bufferedBytes() : loop->numConnections();
+    }
+
+    const bool byBytes_;
+    size_t start_;
+};
+
+class HashByPeerSelector : public LoopSelector
+{
+public:
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *peerAddr) override
+    {
+        if (peerAddr == nullptr)
+        {
+            return roundRobin_.select(loops, peerAddr);
+        }
+        // 只用 IP 不用端口, 同一个客户端的多个连接落在同一个 loop 上
+        uint64_t h = peerAddr->getSockAddr()->sin_addr.s_addr;
+        h *= 0x9E3779B97F4A7C15ULL; // 乘法哈希, 让相邻的地址分散开
+        return loops[(h >> 32) % loops.size()];
+    }
+
+private:
+    RoundRobinSelector roundRobin_;
+};
+
+/**
+ * @brief 随机选两个 loop, 取连接数较少的一个(相同时比较缓冲的字节数)。
+ * @details 只读两个 loop 的计数, 代价与 loop 数量无关,
+ * 而且不会像"总是选最少的"那样让同一批新连接全部涌向同一个 loop。
+ */
+class PowerOfTwoChoicesSelector : public LoopSelector
+{
+public:
+    PowerOfTwoChoicesSelector()
+        : state_(static_cast<uint32_t>(Timestamp::now().microSecondsSinceEpoch()) | 1)
+    {
+    }
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *) override
+    {
+        size_t n = loops.size();
+        if (n == 1)
+        {
+            return loops[0];
+        }
+        size_t i = nextRandom() % n;
+        size_t j = nextRandom() % (n - 1);
+        if (j >= i)
+        {
+            ++j; // 保证两个候选不同
+        }
+        EventLoop *a = loops[i];
+        EventLoop *b = loops[j];
+        size_t connsA = a->numConnections();
+        size_t connsB = b->numConnections();
+        if (connsA != connsB)
+        {
+            return connsA < connsB ? a : b;
+        }
+        return a->bufferedBytes() <= b->bufferedBytes() ? a : b;
+    }
+
+private:
+    /// @brief xorshift32 伪随机数, 只用于打散选择, 不需要高质量的随机数
+    uint32_t nextRandom()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    uint32_t state_;
+};
+} // namespace
+
+LoopSelector *LoopSelector::newSelector(Strategy strategy)
+{
+    switch (strategy)
+    {
+    case kLeastConnections:
+        return new LeastLoadSelector(false);
+    case kLeastPendingBytes:
+        return new LeastLoadSelector(true);
+    case kHashByPeer:
+        return new HashByPeerSelector;
+    case kPowerOfTwoChoices:
+        return new PowerOfTwoChoicesSelector;
+    case kRoundRobin:
+    default:
+        return new RoundRobinSelector;
+    }
+}
+
+const char *LoopSelector::strategyName(Strategy strategy)
+{
+    switch (strategy)
+    {
+    case kLeastConnections:
+        return "least-connections";
+    case kLeastPendingBytes:
+        return "least-pending-bytes";
+    case kHashByPeer:
+        return "hash-by-peer";
+    case kPowerOfTwoChoices:
+        return "power-of-two-choices";
+    case kRoundRobin:
+    default:
+        return "round-robin";
+    }
+}
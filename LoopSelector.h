@@ -0,0 +1,47 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+
+class EventLoop;
+class InetAddress;
+
+/**
+ * @brief 为新连接选择 I/O 线程(subLoop)的策略。
+ * @details
+ * EventLoopThreadPool::getNextLoop 默认按轮询分配, 连接的负载差别很大时,
+ * 长时间存活的重连接可能都落在同一个 loop 上, 其他 loop 却很空闲。
+ * 内置策略使用 EventLoop 上的无锁负载计数(numConnections() 和 bufferedBytes()),
+ * 选择时只读取原子变量, 不需要和 I/O 线程同步。
+ * 也可以继承这个类实现自己的策略, 交给 TcpServer::setLoopSelector。
+ * @note select() 只在 accept 所在的线程(mainLoop)中调用, 实现不需要线程安全。
+ */
+class LoopSelector : noncopyable
+{
+public:
+    /// @brief 内置的选择策略
+    enum Strategy
+    {
+        kRoundRobin,        // 轮询(默认)
+        kLeastConnections,  // 连接数最少的 loop
+        kLeastPendingBytes, // 缓冲数据(输入缓冲区 + 待发送数据)最少的 loop
+        kHashByPeer,        // 按对端 IP 取哈希, 同一个客户端总是落在同一个 loop 上, 便于利用缓存
+        kPowerOfTwoChoices, // 随机选两个 loop, 取连接数较少的一个
+    };
+
+    virtual ~LoopSelector() = default;
+
+    /**
+     * @brief 为一个新连接选择 loop。
+     * @param loops 候选的 loop, 不为空。
+     * @param peerAddr 新连接的对端地址, 不知道时为 nullptr。
+     */
+    virtual EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress *peerAddr) = 0;
+
+    /// @brief 创建内置策略的实例
+    static LoopSelector *newSelector(Strategy strategy);
+
+    /// @brief 策略的名字, 用于日志
+    static const char *strategyName(Strategy strategy);
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 连接缓冲区的内存预算: 单个连接的输入/输出上限, 以及所有连接合计的上限。
+ * @details
+ * 由一个或多个 TcpServer 共享(见 TcpServer::setMemoryBudget), 多个服务(租户)使用同一个对象时
+ * 它们的连接合计受同一个总上限约束。每个连接把自己 inputBuffer_ 和待发送数据的字节数
+ * (不含排队的文件区间)的变化量累加到 usage() 和所属 loop 的 EventLoop::bufferedBytes() 中,
+ * 只在数量变化时做两次 relaxed 原子加法。
+ *
+ * 越过上限时的处理方式:
+ * - kStopReading: 暂停读这个连接, 用量回落后自动恢复。输出越限时待发送的数据照常排队,
+ *   相当于对只读不收的慢速客户端施加反压。
+ * - kDrop: 输出越限时丢弃这一次 send() 的数据(已经部分写出的消息仍会完整排队, 不会截断);
+ *   输入越限时丢弃输入缓冲区中尚未处理的数据。
+ * - kClose: 强制关闭这个连接。
+ *
+ * 上限为0表示不限制。
+ * @note 所有 set 接口必须在服务器 start() 之前调用, 之后只读。
+ */
+class MemoryBudget : noncopyable
+{
+public:
+    enum Action
+    {
+        kStopReading,
+        kDrop,
+        kClose
+    };
+
+    MemoryBudget()
+        : inputLimit_(0),
+          inputAction_(kClose),
+          outputLimit_(0),
+          outputAction_(kStopReading),
+          totalLimit_(0),
+          totalAction_(kStopReading),
+          usage_(0)
+    {
+    }
+
+    /// @brief 单个连接输入缓冲区中未处理数据的上限
+    void setInputLimit(size_t bytes, Action action)
+    {
+        inputLimit_ = bytes;
+        inputAction_ = action;
+    }
+    /// @brief 单个连接待发送数据的上限, 一般远小于高水位标记的默认值 64M
+    void setOutputLimit(size_t bytes, Action action)
+    {
+        outputLimit_ = bytes;
+        outputAction_ = action;
+    }
+    /// @brief 所有连接缓冲数据合计的上限, 处理方式作用于正在增加用量的那个连接
+    void setTotalLimit(size_t bytes, Action action)
+    {
+        totalLimit_ = bytes;
+        totalAction_ = action;
+    }
+
+    size_t inputLimit() const { return inputLimit_; }
+    Action inputAction() const { return inputAction_; }
+    size_t outputLimit() const { return outputLimit_; }
+    Action outputAction() const { return outputAction_; }
+    size_t totalLimit() const { return totalLimit_; }
+    Action totalAction() const { return totalAction_; }
+
+    /// @brief 当前所有连接缓冲的总字节数, 可以在任意线程中读取
+    size_t usage() const
+    {
+        int64_t used = usage_.load(std::memory_order_relaxed);
+        return used > 0 ? static_cast<size_t>(used) : 0;
+    }
+    /// @brief 总用量是否已经超过总上限
+    bool overTotalLimit() const { return totalLimit_ > 0 && usage() > totalLimit_; }
+
+    /// @brief 由 TcpConnection 调用, 累加自己用量的变化
+    void add(int64_t delta) { usage_.fetch_add(delta, std::memory_order_relaxed); }
+
+    static const char *actionName(Action action)
+    {
+        return action == kStopReading ? "stop reading" : action == kDrop ? "drop" : "close";
+    }
+
+private:
+    size_t inputLimit_;
+    Action inputAction_;
+    size_t outputLimit_;
+    Action outputAction_;
+    size_t totalLimit_;
+    Action totalAction_;
+    /// @brief 不同线程的连接并发地加减, 减到0之前可能短暂为负, 所以用有符号数
+    std::atomic<int64_t> usage_;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <utility>
+#include <stddef.h>
+
+/**
+ * @brief 无锁的多生产者单消费者(MPSC)队列。
+ * @details
+ * 采用 Dmitry Vyukov 的侵入式 MPSC 队列算法:
+ * - 生产者只需要一次 exchange(tail_) 和一次 store(next), 互相之间不会阻塞;
+ * - 消费者只访问 head_, 不需要任何原子读-改-写操作。
+ * 队列中始终保留一个“哨兵”节点, 因此 push 和 pop 之间也不存在竞争。
+ *
+ * 节点回收: 消费者弹出的节点会被压入 freeList_ 这个无锁栈中;
+ * 生产者需要节点时优先使用本线程的私有缓存, 缓存为空时用一次 exchange
+ * 把 freeList_ 整个取走放进私有缓存。由于从不单独弹出栈顶节点, 因此不存在 ABA 问题。
+ * 稳定运行后, push/pop 都不会再有任何内存分配。
+ *
+ * @tparam T 元素类型, 必须可默认构造和移动赋值。
+ * @note push() 可以在任意线程调用; pop()/empty() 只能由唯一的消费者线程调用。
+ */
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    MpscQueue()
+        : freeList_(nullptr)
+    {
+        Node *stub = new Node;
+        head_ = stub;
+        tail_.store(stub, std::memory_order_relaxed);
+    }
+
+    ~MpscQueue()
+    {
+        // 析构时不再有生产者, 释放队列中剩余的节点(包括哨兵)和回收栈中的节点
+        deleteList(head_);
+        deleteList(freeList_.load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief 入队一个元素。
+     * @note 线程安全, 可由任意多个线程并发调用。
+     */
+    void push(T &&value)
+    {
+        Node *node = acquireNode();
+        node->value = std::move(value);
+        node->next.store(nullptr, std::memory_order_relaxed);
+        // 先抢占队尾, 再把前驱节点链接到自己。两步之间消费者最多会暂时看到队列为空。
+        Node *prev = tail_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief 批量入队 count 个元素, values 中的元素会被移走。
+     * @details 先在本地把所有节点串成一条链, 再用一次 exchange 挂到队尾,
+     * 无论批量多大, 与其他生产者的竞争都只有一次。
+     * @note 线程安全, 可由任意多个线程并发调用。
+     */
+    void push(T *values, size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        Node *first = acquireNode();
+        first->value = std::move(values[0]);
+        Node *last = first;
+        for (size_t i = 1; i < count; ++i)
+        {
+            Node *node = acquireNode();
+            node->value = std::move(values[i]);
+            last->next.store(node, std::memory_order_relaxed);
+            last = node;
+        }
+        last->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = tail_.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_release);
+    }
+
+    /**
+     * @brief 出队一个元素。
+     * @param value [输出参数] 出队的元素。
+     * @return bool 队列为空时返回 false。
+     * @note 只能由消费者线程调用。
+     */
+    bool pop(T *value)
+    {
+        Node *head = head_;
+        Node *next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        *value = std::move(next->value);
+        // next 成为新的哨兵, 立即释放它持有的资源(例如lambda捕获的对象)
+        next->value = T();
+        head_ = next;
+        releaseNode(head);
+        return true;
+    }
+
+    /**
+     * @brief 判断队列是否为空。
+     * @note 只能由消费者线程调用。
+     */
+    bool empty() const
+    {
+        return head_->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr) {}
+
+        std::atomic<Node *> next;
+        T value;
+    };
+
+    /**
+     * @brief 每个线程私有的空闲节点缓存, 线程退出时释放。
+     * @details 同一元素类型的所有队列共享这一缓存, 节点只是一块内存, 可以在不同队列间复用。
+     */
+    struct NodeCache
+    {
+        NodeCache() : head(nullptr) {}
+        ~NodeCache() { deleteList(head); }
+
+        Node *head;
+    };
+
+    static NodeCache &localCache()
+    {
+        static thread_local NodeCache cache;
+        return cache;
+    }
+
+    Node *acquireNode()
+    {
+        NodeCache &cache = localCache();
+        if (cache.head == nullptr)
+        {
+            // 私有缓存用完了, 一次性取走消费者归还的全部节点
+            cache.head = freeList_.exchange(nullptr, std::memory_order_acquire);
+            if (cache.head == nullptr)
+            {
+                return new Node;
+            }
+        }
+        Node *node = cache.head;
+        cache.head = node->next.load(std::memory_order_relaxed);
+        return node;
+    }
+
+    void releaseNode(Node *node)
+    {
+        Node *old = freeList_.load(std::memory_order_relaxed);
+        do
+        {
+            node->next.store(old, std::memory_order_relaxed);
+        } while (!freeList_.compare_exchange_weak(old, node,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+    }
+
+    static void deleteList(Node *node)
+    {
+        while (node != nullptr)
+        {
+            Node *next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    /// @brief 消费者独占的队头(哨兵节点)。与 tail_ 分处不同的缓存行, 避免伪共享。
+    alignas(64) Node *head_;
+    /// @brief 生产者竞争的队尾。
+    alignas(64) std::atomic<Node *> tail_;
+    /// @brief 消费者归还、生产者批量取走的空闲节点栈。
+    alignas(64) std::atomic<Node *> freeList_;
+};
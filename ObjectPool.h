@@ -0,0 +1,258 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <new>
+#include <cstddef>
+
+/**
+ * @brief 固定大小内存块的线程私有池, 每个块都记得自己属于哪个线程的池。
+ * @details
+ * 与 BufferPool 不同, 这里的对象通常在一个线程分配、在另一个线程释放
+ * (例如 TcpConnection 在 accept 的 loop 中创建, 最后一个引用在 IO loop 中释放)。
+ * 如果释放的块留在释放线程的缓存里, 分配线程的池永远是空的, 所以块总是回到它的来源:
+ * - 所属线程释放时直接挂到本地空闲链表, 不需要任何原子操作;
+ * - 其他线程释放时用 CAS 压入所属池的远程栈;
+ * - 所属线程本地链表为空时, 用一次 exchange 把远程栈整个取走。
+ *   从不单独弹出远程栈的栈顶, 因此不存在 ABA 问题(与 MpscQueue 回收节点的方式相同)。
+ *
+ * 线程退出时池被关闭: 缓存的块还给系统, 之后远程释放的块直接 delete,
+ * 池本身在最后一个块释放后才被销毁。
+ *
+ * @tparam BlockSize 块中对象的大小。
+ */
+template <size_t BlockSize>
+class FixedBlockPool : noncopyable
+{
+public:
+    /// @brief 从当前线程的池中分配一个 BlockSize 字节的块, 按 max_align_t 对齐
+    static void *allocate()
+    {
+        FixedBlockPool *pool = threadPool();
+        Block *block = pool != nullptr ? pool->take() : nullptr;
+        if (block == nullptr)
+        {
+            block = static_cast<Block *>(::operator new(sizeof(Block)));
+            if (pool != nullptr)
+            {
+                pool->refs_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        block->owner = pool;
+        return block->storage;
+    }
+
+    /// @brief 把块还给它所属的池, 可以在任意线程中调用
+    static void deallocate(void *p)
+    {
+        Block *block = reinterpret_cast<Block *>(static_cast<char *>(p) - offsetof(Block, storage));
+        FixedBlockPool *owner = block->owner;
+        if (owner == nullptr)
+        {
+            ::operator delete(block);
+        }
+        else if (owner == t_pool)
+        {
+            owner->putLocal(block);
+        }
+        else
+        {
+            owner->putRemote(block);
+        }
+    }
+
+private:
+    /// @brief 所属线程最多缓存的空闲块数
+    static const size_t kMaxCachedBlocks = 1024;
+
+    struct Block
+    {
+        union
+        {
+            /// @brief 使用中时记录所属的池
+            FixedBlockPool *owner;
+            /// @brief 空闲时串成链表
+            Block *next;
+        };
+        /// @brief 对象存储在头部之后, 保证 max_align_t 对齐
+        alignas(std::max_align_t) char storage[BlockSize];
+    };
+
+    /// @brief 线程退出时关闭本线程的池
+    struct ThreadGuard
+    {
+        ~ThreadGuard()
+        {
+            if (t_pool != nullptr)
+            {
+                t_pool->close();
+                t_pool = nullptr;
+            }
+        }
+    };
+
+    FixedBlockPool()
+        : localHead_(nullptr),
+          localCount_(0),
+          remoteHead_(nullptr),
+          refs_(1) // 所属线程持有一个引用, 每个在外的块各持有一个
+    {
+    }
+
+    static FixedBlockPool *threadPool()
+    {
+        if (t_pool == nullptr && !t_closed)
+        {
+            static thread_local ThreadGuard guard;
+            t_pool = new FixedBlockPool;
+        }
+        return t_pool;
+    }
+
+    /// @brief 远程栈被关闭后的标记, 之后远程释放的块直接 delete
+    static Block *closedMarker() { return reinterpret_cast<Block *>(1); }
+
+    Block *take()
+    {
+        if (localHead_ == nullptr)
+        {
+            // 把其他线程还回来的块整个取走, 第一个直接返回,
+            // 其余的逐个放进本地链表, 由 putLocal 保证缓存不超过 kMaxCachedBlocks
+            Block *remote = remoteHead_.exchange(nullptr, std::memory_order_acquire);
+            if (remote == nullptr)
+            {
+                return nullptr;
+            }
+            Block *block = remote;
+            remote = remote->next;
+            while (remote != nullptr)
+            {
+                Block *next = remote->next;
+                putLocal(remote);
+                remote = next;
+            }
+            return block;
+        }
+        Block *block = localHead_;
+        localHead_ = block->next;
+        --localCount_;
+        return block;
+    }
+
+    void putLocal(Block *block)
+    {
+        if (localCount_ >= kMaxCachedBlocks)
+        {
+            ::operator delete(block);
+            release();
+            return;
+        }
+        block->next = localHead_;
+        localHead_ = block;
+        ++localCount_;
+    }
+
+    void putRemote(Block *block)
+    {
+        Block *head = remoteHead_.load(std::memory_order_relaxed);
+        do
+        {
+            if (head == closedMarker())
+            {
+                ::operator delete(block);
+                release();
+                return;
+            }
+            block->next = head;
+        } while (!remoteHead_.compare_exchange_weak(head, block, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+    }
+
+    void close()
+    {
+        t_closed = true;
+        freeList(localHead_);
+        freeList(remoteHead_.exchange(closedMarker(), std::memory_order_acquire));
+        release(); // 所属线程的引用
+    }
+
+    void freeList(Block *block)
+    {
+        while (block != nullptr)
+        {
+            Block *next = block->next;
+            ::operator delete(block);
+            release();
+            block = next;
+        }
+    }
+
+    /// @brief 块真正还给系统或者线程退出时调用, 最后一个引用释放时销毁池
+    void release()
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    /// @brief 所属线程的空闲链表
+    Block *localHead_;
+    /// @brief 本地空闲链表的长度, 不超过 kMaxCachedBlocks
+    size_t localCount_;
+    /// @brief 其他线程还回来的块
+    std::atomic<Block *> remoteHead_;
+    /// @brief 所属线程的引用 + 尚未还给系统的块数(包括缓存的块)
+    std::atomic<size_t> refs_;
+
+    static thread_local FixedBlockPool *t_pool;
+    static thread_local bool t_closed;
+};
+
+template <size_t BlockSize>
+thread_local FixedBlockPool<BlockSize> *FixedBlockPool<BlockSize>::t_pool = nullptr;
+template <size_t BlockSize>
+thread_local bool FixedBlockPool<BlockSize>::t_closed = false;
+
+/**
+ * @brief 使用 FixedBlockPool 的分配器, 配合 std::allocate_shared 使用时,
+ * 对象和 shared_ptr 的控制块在同一个池化的块中。
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned type");
+        if (n == 1)
+        {
+            return static_cast<T *>(FixedBlockPool<sizeof(T)>::allocate());
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n == 1)
+        {
+            FixedBlockPool<sizeof(T)>::deallocate(p);
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
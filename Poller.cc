@@ -1,10 +1,45 @@
 #include "Poller.h"
 
+#include <assert.h>
+
 Poller::Poller(EventLoop *loop)
-    : ownerLoop_(loop) {}
+    : numChannels_(0),
+      ownerLoop_(loop) {}
 
 bool Poller::hasChannel(Channel *channel) const
 {
-    ChannelMap::const_iterator it = channels_.find(channel->fd());
-    return (it != channels_.end() && it->second == channel);
+    return findChannel(channel->fd()) == channel;
+}
+
+uint32_t Poller::addChannelSlot(Channel *channel)
+{
+    int fd = channel->fd();
+    assert(fd >= 0);
+    if (static_cast<size_t>(fd) >= channels_.size())
+    {
+        // 按2的幂扩容, 新槽位清零
+        size_t newSize = channels_.empty() ? 64 : channels_.size();
+        while (newSize <= static_cast<size_t>(fd))
+        {
+            newSize *= 2;
+        }
+        channels_.resize(newSize, ChannelSlot{nullptr, 0});
+    }
+    ChannelSlot &slot = channels_[fd];
+    if (slot.channel == nullptr)
+    {
+        ++numChannels_;
+    }
+    slot.channel = channel;
+    return ++slot.generation;
+}
+
+void Poller::removeChannelSlot(int fd)
+{
+    if (static_cast<size_t>(fd) < channels_.size() && channels_[fd].channel != nullptr)
+    {
+        channels_[fd].channel = nullptr;
+        ++channels_[fd].generation;
+        --numChannels_;
+    }
 }
@@ -5,14 +5,34 @@
 #include "Channel.h"
 
 #include <vector>
-#include <unordered_map>
+#include <stdint.h>
 
 class EventLoop;
 // muduo库中，多路事件分发器的核心IO复用模块
 class Poller : noncopyable
 {
 public:
-    using ChannelList = std::vector<Channel *>;
+    /**
+     * @brief poll() 返回的一个活跃事件。
+     * @details 除了 Channel 本身, 还记录了事件产生时 fd 槽位的代数(generation)。
+     * 同一批事件中, 如果前面的回调关闭了某个fd、而它又被新连接复用,
+     * 后面属于旧连接的事件会因为代数不一致被 isCurrent() 识别出来并丢弃。
+     */
+    struct ActiveChannel
+    {
+        Channel *channel;
+        int fd;
+        uint32_t generation;
+    };
+    using ChannelList = std::vector<ActiveChannel>;
+
+    /// @brief 可选的IO复用后端
+    enum Backend
+    {
+        kDefaultBackend, // 由环境变量决定: 设置了 MUDUO_USE_IOURING 时使用 io_uring, 否则使用 epoll
+        kEPollBackend,
+        kIoUringBackend, // 内核不支持时自动退回 epoll
+    };
 
     Poller(EventLoop *loop);
     virtual ~Poller() = default;
@@ -22,15 +42,52 @@ public:
     virtual void updateChannel(Channel *channel) = 0;
     virtual void removeChannel(Channel *channel) = 0;
 
+    // 是否支持边缘触发(Channel::enableEdgeTriggered)
+    virtual bool edgeTriggeredSupported() const { return false; }
+
     // 判断参数channel是否在当前Poller当中
     bool hasChannel(Channel *channel) const;
 
+    /**
+     * @brief 判断一个活跃事件是否仍然属于当前注册在该fd上的 Channel。
+     * @note EventLoop 在分发每个事件之前调用, O(1)。
+     */
+    bool isCurrent(const ActiveChannel &active) const
+    {
+        return static_cast<size_t>(active.fd) < channels_.size() &&
+               channels_[active.fd].channel == active.channel &&
+               channels_[active.fd].generation == active.generation;
+    }
+
     //EventLoop可以通过该接口获取默认的IO复用的具体实现
     static Poller *newDefaultPoller(EventLoop *loop);
+    //按指定的后端创建Poller
+    static Poller *newPoller(EventLoop *loop, Backend backend);
 
 protected:
-    using ChannelMap = std::unordered_map<int, Channel *>;
-    ChannelMap channels_;
+    /// @brief fd 对应的槽位。fd 是内核分配的最小可用整数, 用它直接做下标既紧凑又是 O(1) 的。
+    struct ChannelSlot
+    {
+        Channel *channel;
+        /// @brief 槽位每次被添加或移除 Channel 时加一, 用于识别过期的事件
+        uint32_t generation;
+    };
+    using ChannelTable = std::vector<ChannelSlot>;
+
+    /// @brief 把 channel 放入它的fd对应的槽位, 表不够大时按需扩容。返回新的代数。
+    uint32_t addChannelSlot(Channel *channel);
+    /// @brief 清空fd对应的槽位。
+    void removeChannelSlot(int fd);
+    /// @brief 查找fd当前对应的 Channel, 没有时返回 nullptr。
+    Channel *findChannel(int fd) const
+    {
+        return static_cast<size_t>(fd) < channels_.size() ? channels_[fd].channel : nullptr;
+    }
+    uint32_t generationOf(int fd) const { return channels_[fd].generation; }
+
+    ChannelTable channels_;
+    /// @brief 当前注册的 Channel 个数
+    size_t numChannels_;
 
 private:
     EventLoop *ownerLoop_; // 定义Poller所属的事件循环EventLoop
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <stddef.h>
+
+/**
+ * @brief 不可变的、引用计数的消息内容, 用于把同一份数据发给很多连接。
+ * @details
+ * 拷贝一个 SharedPayload 只是增加引用计数。TcpConnection::send(const SharedPayload&)
+ * 发不完的部分不会拷贝进输出缓冲区, 而是把这块内存作为只读块直接挂进去,
+ * 所有连接都发送完毕(引用全部释放)后内存才会被释放。
+ * 例如把一条 4K 的消息推送给 2 万个订阅者, 内存中始终只有一份数据。
+ * @note 构造之后内容不能再修改, 因此可以在任意线程之间共享。
+ */
+class SharedPayload
+{
+public:
+    SharedPayload() = default;
+
+    explicit SharedPayload(std::string data)
+        : data_(std::make_shared<std::string>(std::move(data)))
+    {
+    }
+
+    SharedPayload(const void *data, size_t len)
+        : data_(std::make_shared<std::string>(static_cast<const char *>(data), len))
+    {
+    }
+
+    const char *data() const { return data_ ? data_->data() : ""; }
+    size_t size() const { return data_ ? data_->size() : 0; }
+    bool empty() const { return size() == 0; }
+    std::string_view view() const { return std::string_view(data(), size()); }
+
+    /// @brief 持有数据的引用, 供 Buffer::appendShared 使用
+    std::shared_ptr<void> owner() const { return data_; }
+
+private:
+    std::shared_ptr<std::string> data_;
+};
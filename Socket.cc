@@ -7,6 +7,11 @@
 #include <sys/socket.h>
 #include <strings.h> // bzero
 #include <netinet/tcp.h> // 包含了 TCP_NODELAY 选项
+#include <errno.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60 // 旧版本的 glibc 头文件中没有这个定义
+#endif
 
 /**
  * @brief Socket 析构函数, 在对象销毁时自动关闭 socket 文件描述符。
@@ -85,7 +90,11 @@ int Socket::accept(InetAddress *peeraddr)
     {
         // accept 失败可能是多种原因, 有些是可恢复的(如被信号中断),
         // 所以这里记录为错误日志, 而不是致命日志。
-        LOG_ERROR("accept err:%d \n", errno);
+        // EAGAIN 只表示全连接队列已经取空, 批量 accept 时每次都会遇到, 不记录。
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("accept err:%d \n", errno);
+        }
     }
 
     return connfd;
@@ -168,4 +177,40 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 设置 SO_BUSY_POLL 选项 (socket 级别的忙轮询)。
+ * @param microseconds 接收队列为空时, 在网卡驱动队列上忙等的最长时间(微秒), 0 表示关闭。
+ * @details
+ * 开启后, 对该 socket 的阻塞读以及 epoll_wait 会先直接轮询网卡的接收队列,
+ * 绕过中断和软中断的调度延迟。需要网卡驱动支持 NAPI busy poll,
+ * 并且设置比系统默认值(net.core.busy_read)更大的值时需要 CAP_NET_ADMIN 权限。
+ * @return bool 设置成功返回 true。
+ */
+bool Socket::setBusyPoll(int microseconds)
+{
+    int optval = microseconds;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &optval, sizeof(optval)) < 0)
+    {
+        LOG_ERROR("Socket::setBusyPoll fd=%d error:%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 设置 SO_ZEROCOPY 选项, 之后才能使用 send(MSG_ZEROCOPY)。
+ * @details 需要 Linux 4.14 及以上的内核, 不支持时返回 false。
+ * @return bool 设置成功返回 true。
+ */
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) < 0)
+    {
+        LOG_ERROR("Socket::setZeroCopy fd=%d error:%d\n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
@@ -24,6 +24,8 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    bool setBusyPoll(int microseconds);
+    bool setZeroCopy(bool on);
 
 private:
     const int sockfd_;
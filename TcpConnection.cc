@@ -3,9 +3,46 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "IoUringPoller.h"
 
 #include <functional>
+#include <algorithm>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h> // for IOV_MAX
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000 // 旧版本的 glibc 头文件中没有这个定义
+#endif
+
+// 边缘触发模式下单次写事件最多处理的字节数, 超出后留到下一轮循环继续
+static const size_t kEdgeTriggeredBudget = 1024 * 1024;
+
+// 完成式收发发送文件时每次 pread 的大小
+static const size_t kFileReadChunk = 64 * 1024;
+
+// 直接发送或零拷贝发送一次最多提交的块数
+static const int kMaxSendIov = 64;
+// 内核连续这么多次报告零拷贝实际仍然拷贝了, 就退回普通发送
+static const int kZeroCopyCopiedLimit = 8;
+
+// 单次读事件默认最多读取的字节数
+static const size_t kDefaultReadBudget = 256 * 1024;
+
+// 每次读取前预留的可写空间的初始值和上下限, 放不下的数据由 loop 的读临时区兜底
+static const size_t kInitialReadSize = 4 * 1024;
+static const size_t kMinReadSize = 512;
+static const size_t kMaxReadSize = 64 * 1024;
+
+// 因为超出内存预算暂停读取后, 每隔这么久检查一次用量是否已经回落(秒)
+static const double kBudgetRecheckInterval = 0.1;
 
 // 辅助函数, 用于检查并确保传入的EventLoop指针有效, 防止后续的空指针解引用
 static EventLoop *checkLoopNotNull(EventLoop *loop)
@@ -26,19 +63,44 @@ static EventLoop *checkLoopNotNull(EventLoop *loop)
  * 并预设好当底层事件发生时, 应该由TcpConnection的哪个成员函数来处理。
  */
 TcpConnection::TcpConnection(EventLoop *loop,
-                             const std::string &nameArg,
+                             uint64_t id,
+                             std::shared_ptr<const std::string> namePrefix,
                              int sockfd,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
     : loop_(checkLoopNotNull(loop)), // 必须属于一个subLoop
-      name_(nameArg),
-      state_(kConnecting),                 // 初始状态为“正在连接”
-                                           //   reading_(true),
-      socket_(new Socket(sockfd)),         // 封装已连接的sockfd
-      channel_(new Channel(loop, sockfd)), // 为该sockfd创建一个专属的Channel
+      id_(id),
+      namePrefix_(std::move(namePrefix)),
+      state_(kConnecting),     // 初始状态为“正在连接”
+      reading_(true),
+      socket_(sockfd),         // 封装已连接的sockfd
+      channel_(loop, sockfd),  // 为该sockfd创建一个专属的Channel
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) // 默认高水位标记64M
+      highWaterMark_(64 * 1024 * 1024), // 默认高水位标记64M
+      readBudget_(kDefaultReadBudget),
+      readSizeHint_(kInitialReadSize),
+      readShrinkPending_(false),
+      edgeTriggeredRequested_(false),
+      edgeTriggered_(false),
+      completionIoRequested_(false),
+      completionIo_(false),
+      recvInFlight_(false),
+      sendInFlight_(false),
+      recvOperation_(0),
+      sendOperation_(0),
+      pendingFileBytes_(0),
+      zeroCopyThreshold_(0),
+      zeroCopy_(false),
+      zeroCopyNextSeq_(0),
+      zeroCopyCopiedStreak_(0),
+      zeroCopySendCount_(0),
+      zeroCopyCopiedCount_(0),
+      accountedBytes_(0),
+      readPausedByBudget_(false),
+      budgetRecheckScheduled_(false),
+      backpressureMark_(0),
+      backpressureApplied_(false)
 {
     // 【核心回调绑定】
     // 将 Channel 上的底层事件回调, 精确地绑定到 TcpConnection 的成员函数上。
@@ -47,29 +109,52 @@ TcpConnection::TcpConnection(EventLoop *loop,
     // - "如果可以向客户发送更多数据(可写事件), 就执行我的 handleWrite 方法"
     // - "如果连接线路被挂断, 就执行我的 handleClose 方法"
     // - "如果线路出错, 就执行我的 handleError 方法"
-    channel_->setReadCallback(
+    channel_.setReadCallback(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
+    channel_.setWriteCallback(
         std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true); // 默认开启TCP保活机制
+    // 输出缓冲区使用分段模式: 追加大块数据时不会移动已有数据, 发送时用 writev 一次发出
+    outputBuffer_.setChunked(true);
+    sendingBuffer_.setChunked(true);
+
+    // 不在这里打印名称, 否则每个连接都要生成一次名称字符串
+    LOG_DEBUG("TcpConnection::ctor id=%llu at fd=%d", static_cast<unsigned long long>(id_), sockfd);
+    socket_.setKeepAlive(true); // 默认开启TCP保活机制
+    // 创建时就计入, 同一批新连接在 connectEstablished 之前也能被 LoopSelector 看到
+    loop_->addConnections(1);
 }
 
 /**
  * @brief TcpConnection 析构函数
  * @details 打印日志以方便追踪连接的销毁时机。
- * 由于socket_和channel_都是unique_ptr, 它们的资源会在这里被自动释放,
+ * socket_和channel_都是成员对象, 它们的资源会在这里被自动释放,
  * 完美符合RAII的要求。
  */
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d",
-             name_.c_str(), channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::dtor id=%llu at fd=%d state=%d",
+              static_cast<unsigned long long>(id_), channel_.fd(), (int)state_);
+    for (const PendingFile &file : pendingFiles_)
+    {
+        ::close(file.fd); // 没来得及发完的文件
+    }
+    // 与构造函数中的计数配对, 即使连接没有走到 connectDestroyed(例如 loop 退出时丢弃了 connectEstablished)
+    loop_->addConnections(-1);
+}
+
+const std::string &TcpConnection::name() const
+{
+    std::call_once(nameOnce_, [this]() {
+        char buf[32];
+        snprintf(buf, sizeof buf, "#%u", static_cast<unsigned>(id_ >> 32));
+        name_ = (namePrefix_ ? *namePrefix_ : std::string()) + buf;
+    });
+    return name_;
 }
 
 /**
@@ -130,6 +215,88 @@ void TcpConnection::send(std::string &&buf)
     }
 }
 
+void TcpConnection::send(std::string_view message)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(message.data(), message.size());
+        }
+        else
+        {
+            // 调用返回后 message 指向的内存就可能失效, 只能拷贝一份
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, buf = std::string(message)]() {
+                conn->sendInLoop(buf.data(), buf.size());
+            });
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf);
+        }
+        else
+        {
+            // 先把数据块转移到一个分段模式的 Buffer 中, 再把它移动进闭包, 全程不拷贝数据
+            Buffer data;
+            data.setChunked(true);
+            data.append(buf);
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, data = std::move(data)]() mutable {
+                conn->sendInLoop(&data);
+            });
+        }
+    }
+}
+
+void TcpConnection::sendv(const struct iovec *iov, int iovcnt)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendvInLoop(iov, iovcnt);
+        }
+        else
+        {
+            // 片段的内存不归连接所有, 拷贝进一个分段模式的 Buffer(只拷贝这一次)
+            Buffer data;
+            data.setChunked(true);
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                data.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+            }
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, data = std::move(data)]() mutable {
+                conn->sendInLoop(&data);
+            });
+        }
+    }
+}
+
+void TcpConnection::send(const SharedPayload &payload)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(payload);
+        }
+        else
+        {
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, payload]() { conn->sendInLoop(payload); });
+        }
+    }
+}
+
 /**
  * @brief 【非线程安全的私有实现】在IO线程中执行的实际发送逻辑。
  * @details
@@ -153,10 +320,6 @@ void TcpConnection::send(std::string &&buf)
  */
 void TcpConnection::sendInLoop(const void *data, size_t len)
 {
-    ssize_t nwrote = 0;
-    size_t remaining = len;
-    bool faultError = false;
-
     // 如果之前调用过 shutdown, 则不能再发送新数据
     if (state_ == kDisconnected)
     {
@@ -166,52 +329,28 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
 
     // 优化: 如果输出缓冲区为空, 尝试直接发送。
     // 这可以避免一次不必要的内存拷贝(从用户数据到outputBuffer_)
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = len;
+    ssize_t nwrote = writeDirect(&iov, 1, len);
+    if (nwrote < 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
-        if (nwrote >= 0)
-        {
-            remaining = len - nwrote;
-            // 如果数据一次性发送完毕
-            if (remaining == 0 && writeCompleteCallback_)
-            {
-                // 调用用户的“写完成回调”。因为可能在回调里做耗时操作,
-                // 所以使用queueInLoop确保在下一轮事件循环中执行, 不阻塞当前IO处理。
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-            }
-        }
-        else // nwrote < 0, write 出错
-        {
-            nwrote = 0;
-            // EWOULDBLOCK 表示内核发送缓冲区已满, 是正常情况, 不算错误
-            if (errno != EWOULDBLOCK)
-            {
-                LOG_ERROR("TcpConnection::sendInLoop");
-                if (errno == EPIPE || errno == ECONNRESET) // 对端重置连接等错误
-                {
-                    faultError = true;
-                }
-            }
-        }
+        return;
     }
 
     // 如果数据没有一次性发完, 或者首次发送就遇到缓冲区满
-    if (!faultError && remaining > 0)
+    size_t remaining = len - nwrote;
+    if (remaining > 0)
     {
-        size_t oldLen = outputBuffer_.readableBytes();
         // 检查是否达到高水位标记
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
-        {
-            // 触发高水位回调, 通知用户发送速度过快, 应用层应减缓发送
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
-        }
-        // 将剩余数据追加到 outputBuffer_
-        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
-        if (!channel_->isWriting())
+        checkHighWaterMark(remaining);
+        if (!checkOutputLimit(remaining, nwrote > 0))
         {
-            // 开始监听可写事件(EPOLLOUT), 以便在socket可写时, 内核能通知我们继续发送
-            channel_->enableWriting();
+            return;
         }
+        // 将剩余数据追加到 outputBuffer_; 前面有排队的文件时, 要排在最后一个文件之后
+        outputTail()->append(static_cast<const char *>(data) + nwrote, remaining);
+        startOutput();
     }
 }
 
@@ -221,169 +360,1184 @@ void TcpConnection::sendInLoop(const std::string &message)
     sendInLoop(message.data(), message.size());
 }
 
-/**
- * @brief 【线程安全的公有接口】关闭连接 (半关闭)。
- * @details
- * "半关闭"是指关闭本端的写通道, 但仍然可以接收数据。
- * 这是实现优雅关闭(graceful shutdown)的标准做法。
- */
-void TcpConnection::shutdown()
+void TcpConnection::sendInLoop(std::string &&message)
 {
-    if (state_ == kConnected)
+    if (!zeroCopy_ || message.size() < zeroCopyThreshold_)
     {
-        setState(kDisconnecting); // 进入“正在关闭”状态
-        // 同样, 将实际操作派发给IO线程执行
-        loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+        sendInLoop(message.data(), message.size());
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
     }
-}
 
-/**
- * @brief 【非线程安全的私有实现】在IO线程中执行的实际关闭逻辑。
- */
-void TcpConnection::shutdownInLoop()
-{
-    // 只有当输出缓冲区的数据全部发送完毕后, 才能关闭写端。
-    // 如果还在监听可写事件, 说明数据还没发完, handleWrite会接管关闭流程。
-    if (!channel_->isWriting())
+    // 零拷贝: 不把数据拷贝进 outputBuffer_, 而是把字符串本身挂进去, 由 handleWrite 用 MSG_ZEROCOPY 发出
+    size_t len = message.size();
+    checkHighWaterMark(len);
+    if (!checkOutputLimit(len, false))
+    {
+        return;
+    }
+    std::shared_ptr<std::string> holder = std::make_shared<std::string>(std::move(message));
+    outputTail()->appendShared(holder, holder->data(), len);
+    updateMemoryUsage();
+    checkBackpressure();
+    if (!channel_.isWriting())
     {
-        socket_->shutdownWrite(); // 调用底层的 shutdown(SHUT_WR)
+        channel_.enableWriting();
+        handleWrite(); // 立即尝试发送, 全部发完时 handleWrite 会再关闭写事件
     }
 }
 
-/**
- * @brief 【非线程安全】当连接成功建立后, 在其所属的IO线程中被调用。
- * @details
- * 这是连接生命周期的“正式开始”。
- */
-void TcpConnection::connectEstablished()
+void TcpConnection::sendInLoop(Buffer *buf)
 {
-    setState(kConnected); // 设置状态为“已连接”
-    // 【核心安全机制】将 Channel 与 TcpConnection 的 shared_ptr 绑定。
-    // 这确保了即使上层(TcpServer)已经释放了对这个TcpConnection的shared_ptr,
-    // 只要Channel还活着(还在Poller的监听列表里), 这个TcpConnection对象就不会被析构。
-    channel_->tie(shared_from_this());
-
-    channel_->enableReading(); // 正式开始监听读事件
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
 
-    // 执行用户设置的连接建立回调
-    connectionCallback_(shared_from_this());
+    struct iovec iov[kMaxSendIov];
+    int count = buf->peekIovec(iov, kMaxSendIov);
+    ssize_t nwrote = writeDirect(iov, count, buf->readableBytes());
+    if (nwrote < 0)
+    {
+        return;
+    }
+    buf->retrieve(nwrote);
+    if (buf->readableBytes() > 0)
+    {
+        checkHighWaterMark(buf->readableBytes());
+        if (!checkOutputLimit(buf->readableBytes(), nwrote > 0))
+        {
+            buf->retrieveAll();
+            return;
+        }
+        outputTail()->append(buf); // 接管剩下的数据块, 不拷贝
+        startOutput();
+    }
 }
 
-/**
- * @brief 【非线程安全】当连接被销毁前, 在其所属的IO线程中被调用。
- * @details
- * 这是连接生命周期的“最终清理”。
- */
-void TcpConnection::connectDestroyed()
+void TcpConnection::sendvInLoop(const struct iovec *iov, int iovcnt)
 {
-    if (state_ == kConnected)
+    if (state_ == kDisconnected)
     {
-        setState(kDisconnected);
-        channel_->disableAll();                  // 停止所有事件监听
-        connectionCallback_(shared_from_this()); // 执行用户设置的连接断开回调
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        total += iov[i].iov_len;
+    }
+    ssize_t nwrote = writeDirect(iov, iovcnt, total);
+    if (nwrote < 0 || static_cast<size_t>(nwrote) == total)
+    {
+        return;
+    }
+
+    checkHighWaterMark(total - nwrote);
+    if (!checkOutputLimit(total - nwrote, nwrote > 0))
+    {
+        return;
+    }
+    // 跳过已经写出的部分, 剩下的片段逐段追加
+    Buffer *tail = outputTail();
+    size_t skip = nwrote;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        if (skip >= iov[i].iov_len)
+        {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        tail->append(static_cast<const char *>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+        skip = 0;
     }
-    channel_->remove(); // 将 Channel 从 Poller 中彻底移除
+    startOutput();
 }
 
-/**
- * @brief 【非线程安全】Channel 的读事件回调, 由 EventLoop 触发
- */
-void TcpConnection::handleRead(Timestamp receiveTime)
+void TcpConnection::sendInLoop(const SharedPayload &payload)
 {
-    int savedErrno = 0;
-    // 从 socket 读取数据到 inputBuffer_
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0) // 成功读取到数据
+    if (state_ == kDisconnected)
     {
-        // 调用用户的消息回调, 将数据和时间戳交给用户处理
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        LOG_ERROR("disconnected, give up writing!");
+        return;
     }
-    else if (n == 0) // read 返回0, 表示对端已正常关闭连接
+
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(payload.data());
+    iov.iov_len = payload.size();
+    ssize_t nwrote = writeDirect(&iov, 1, payload.size());
+    if (nwrote < 0)
     {
-        handleClose();
+        return;
     }
-    else // n < 0, 表示出错
+    size_t remaining = payload.size() - nwrote;
+    if (remaining > 0)
     {
-        errno = savedErrno;
-        LOG_ERROR("TcpConnection::handleRead");
-        handleError();
+        checkHighWaterMark(remaining);
+        if (!checkOutputLimit(remaining, nwrote > 0))
+        {
+            return;
+        }
+        // 不拷贝, 引用同一块内存
+        outputTail()->appendShared(payload.owner(), payload.data() + nwrote, remaining);
+        startOutput();
     }
 }
 
-/**
- * @brief 【非线程安全】Channel 的写事件回调, 由 EventLoop 触发
- */
-void TcpConnection::handleWrite()
+ssize_t TcpConnection::writeDirect(const struct iovec *iov, int iovcnt, size_t total)
 {
-    if (channel_->isWriting()) // 确保仍在监听写事件
+    // 完成式收发总是交给 io_uring, 和其他请求一起批量提交
+    if (completionIo_ || channel_.isWriting() || hasPendingOutput() || total == 0)
     {
-        // 从 outputBuffer_ 向 socket 写入数据
-        ssize_t n = ::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
-        if (n > 0)
-        {
-            outputBuffer_.retrieve(n);              // 从缓冲区消耗掉已发送的数据
-            if (outputBuffer_.readableBytes() == 0) // 如果数据已全部发送完毕
-            {
-                // 【核心】必须停止监听写事件, 否则会因为socket一直可写而导致此回调被不停触发, 造成CPU 100% (busy-loop)。
-                channel_->disableWriting();
+        return 0;
+    }
 
-                if (writeCompleteCallback_)
-                {
-                    // 调用用户的写完成回调, 通知用户数据已发完
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                }
+    ssize_t nwrote = iovcnt == 1 ? ::write(channel_.fd(), iov[0].iov_base, iov[0].iov_len)
+                                 : ::writev(channel_.fd(), iov, std::min(iovcnt, IOV_MAX));
+    if (nwrote >= 0)
+    {
+        // 如果数据一次性发送完毕
+        if (static_cast<size_t>(nwrote) == total && writeCompleteCallback_)
+        {
+            // 调用用户的“写完成回调”。因为可能在回调里做耗时操作,
+            // 所以使用queueInLoop确保在下一轮事件循环中执行, 不阻塞当前IO处理。
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        return nwrote;
+    }
 
-                // 如果当前状态是“正在关闭”, 那么在数据发完后, 执行半关闭
-                if (state_ == kDisconnecting)
-                {
-                    shutdownInLoop();
-                }
-            }
+    // EWOULDBLOCK 表示内核发送缓冲区已满, 是正常情况, 不算错误
+    if (errno != EWOULDBLOCK)
+    {
+        LOG_ERROR("TcpConnection::sendInLoop");
+        if (errno == EPIPE || errno == ECONNRESET) // 对端重置连接等错误
+        {
+            return -1;
         }
-        else
+    }
+    return 0;
+}
+
+void TcpConnection::startOutput()
+{
+    updateMemoryUsage();
+    checkBackpressure();
+    if (completionIo_)
+    {
+        if (!sendInFlight_)
         {
-            LOG_ERROR("TcpConnection::handleWrite failed, errno:%d", errno);
+            startSend();
         }
     }
-    else
+    else if (!channel_.isWriting())
     {
-        LOG_ERROR("TcpConnection fd=%d is down, no more writing", channel_->fd());
+        // 开始监听可写事件(EPOLLOUT), 以便在socket可写时, 内核能通知我们继续发送
+        channel_.enableWriting();
     }
 }
 
-/**
- * @brief 【非线程安全】Channel 的关闭事件回调, 或由 handleRead 调用
- * @details
- * 这是连接关闭的中央处理函数, 负责状态转换和回调通知。
- */
-void TcpConnection::handleClose()
+void TcpConnection::checkHighWaterMark(size_t adding)
 {
-    setState(kDisconnected);
-    channel_->disableAll(); // 停止监听任何事件
+    size_t oldLen = pendingOutputBytes();
+    if (oldLen + adding >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+    {
+        // 触发高水位回调, 通知用户发送速度过快, 应用层应减缓发送
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + adding));
+    }
+}
 
-    TcpConnectionPtr connPtr(shared_from_this());
-    // 执行用户的连接回调 (表示连接已断开)
-    connectionCallback_(connPtr);
-    // 【核心】执行TcpServer设置的关闭回调, 其作用是通知TcpServer将自己从连接列表中移除。
-    closeCallback_(connPtr);
+bool TcpConnection::checkOutputLimit(size_t adding, bool partiallySent)
+{
+    if (!memoryBudget_)
+    {
+        return true;
+    }
+    size_t output = pendingOutputBytes() - pendingFileBytes_ + adding;
+    MemoryBudget::Action action;
+    if (memoryBudget_->outputLimit() > 0 && output > memoryBudget_->outputLimit())
+    {
+        action = memoryBudget_->outputAction();
+    }
+    else if (memoryBudget_->totalLimit() > 0 && memoryBudget_->usage() + adding > memoryBudget_->totalLimit())
+    {
+        action = memoryBudget_->totalAction();
+    }
+    else
+    {
+        return true;
+    }
+
+    switch (action)
+    {
+    case MemoryBudget::kStopReading:
+        pauseReadingForBudget(); // 数据照常排队, 不再读取这个连接的新请求
+        return true;
+    case MemoryBudget::kDrop:
+        if (partiallySent)
+        {
+            return true; // 已经写出了一部分, 丢弃剩下的会破坏字节流
+        }
+        LOG_ERROR("TcpConnection[%s] output over memory budget, drop %zu bytes", name().c_str(), adding);
+        return false;
+    case MemoryBudget::kClose:
+        LOG_ERROR("TcpConnection[%s] output over memory budget (%zu bytes), closing", name().c_str(), output);
+        forceClose();
+        return false;
+    }
+    return true;
 }
 
-/**
- * @brief 【非线程安全】Channel 的错误事件回调
- */
-void TcpConnection::handleError()
+void TcpConnection::checkInputLimit()
 {
-    int optval;
-    socklen_t optlen = static_cast<socklen_t>(sizeof optval);
-    int err = 0;
-    // 使用 getsockopt(SO_ERROR) 获取底层的 socket 错误码, 这是处理socket异步错误的標準方法
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    updateMemoryUsage();
+    if (!memoryBudget_ || state_ == kDisconnected)
     {
-        err = errno;
+        return;
+    }
+    size_t input = inputBuffer_.readableBytes();
+    MemoryBudget::Action action;
+    if (memoryBudget_->inputLimit() > 0 && input > memoryBudget_->inputLimit())
+    {
+        action = memoryBudget_->inputAction();
+    }
+    else if (memoryBudget_->overTotalLimit() && accountedBytes_ > 0)
+    {
+        // 总量超限只约束自己还缓冲着数据的连接, 数据都处理完的连接总能继续前进
+        action = memoryBudget_->totalAction();
     }
     else
     {
-        err = optval;
+        return;
     }
-    LOG_ERROR("TcpConnection::handleError name:[%s] - SO_ERROR = %d", name_.c_str(), err);
-}
\ No newline at end of file
+
+    switch (action)
+    {
+    case MemoryBudget::kStopReading:
+        pauseReadingForBudget();
+        break;
+    case MemoryBudget::kDrop:
+        if (input > 0)
+        {
+            LOG_ERROR("TcpConnection[%s] input over memory budget, drop %zu bytes", name().c_str(), input);
+            inputBuffer_.retrieveAll();
+            updateMemoryUsage();
+        }
+        break;
+    case MemoryBudget::kClose:
+        LOG_ERROR("TcpConnection[%s] input over memory budget (%zu bytes), closing", name().c_str(), input);
+        forceClose();
+        break;
+    }
+}
+
+void TcpConnection::updateMemoryUsage()
+{
+    if (state_ == kDisconnected)
+    {
+        return; // 关闭时已经撤销了全部用量
+    }
+    size_t bytes = inputBuffer_.readableBytes() + pendingOutputBytes() - pendingFileBytes_;
+    if (bytes != accountedBytes_)
+    {
+        int64_t delta = static_cast<int64_t>(bytes) - static_cast<int64_t>(accountedBytes_);
+        loop_->addBufferedBytes(delta);
+        if (memoryBudget_)
+        {
+            memoryBudget_->add(delta);
+        }
+        accountedBytes_ = bytes;
+    }
+
+    if (readPausedByBudget_ && budgetAllowsReading())
+    {
+        readPausedByBudget_ = false;
+        LOG_DEBUG("TcpConnection[%s] memory usage back under budget, resume reading", name().c_str());
+        updateReadInterest();
+    }
+}
+
+void TcpConnection::releaseMemoryUsage()
+{
+    if (accountedBytes_ > 0)
+    {
+        int64_t delta = -static_cast<int64_t>(accountedBytes_);
+        loop_->addBufferedBytes(delta);
+        if (memoryBudget_)
+        {
+            memoryBudget_->add(delta);
+        }
+        accountedBytes_ = 0;
+    }
+}
+
+void TcpConnection::pauseReadingForBudget()
+{
+    if (!readPausedByBudget_)
+    {
+        readPausedByBudget_ = true;
+        LOG_INFO("TcpConnection[%s] over memory budget with %zu bytes buffered, stop reading",
+                 name().c_str(), accountedBytes_);
+        updateReadInterest();
+    }
+    if (!budgetRecheckScheduled_)
+    {
+        // 用户可能在回调之外消费输入, 其他连接也可能释放了总用量, 都不会经过本连接, 所以定时检查
+        budgetRecheckScheduled_ = true;
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        loop_->runAfter(kBudgetRecheckInterval, [weakConn]() {
+            TcpConnectionPtr conn = weakConn.lock();
+            if (conn)
+            {
+                conn->budgetRecheckScheduled_ = false;
+                conn->updateMemoryUsage();
+                if (conn->readPausedByBudget_ && conn->state_ != kDisconnected)
+                {
+                    conn->pauseReadingForBudget();
+                }
+            }
+        });
+    }
+}
+
+bool TcpConnection::budgetAllowsReading() const
+{
+    // 输出和总用量回落到上限的 3/4 以下才恢复, 避免在上限附近反复暂停/恢复。
+    // 总用量是所有连接共同造成的, 本连接的数据全部发完后也可以恢复, 否则可能一直等待其他连接
+    const MemoryBudget &budget = *memoryBudget_;
+    if (budget.inputLimit() > 0 && budget.inputAction() == MemoryBudget::kStopReading &&
+        inputBuffer_.readableBytes() >= budget.inputLimit())
+    {
+        return false;
+    }
+    size_t output = pendingOutputBytes() - pendingFileBytes_;
+    if (budget.outputLimit() > 0 && budget.outputAction() == MemoryBudget::kStopReading &&
+        output > budget.outputLimit() - budget.outputLimit() / 4)
+    {
+        return false;
+    }
+    if (budget.totalLimit() > 0 && budget.totalAction() == MemoryBudget::kStopReading &&
+        accountedBytes_ > 0 && budget.usage() > budget.totalLimit() - budget.totalLimit() / 4)
+    {
+        return false;
+    }
+    return true;
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected)
+    {
+        // 复制一份 fd, 发送期间不依赖调用方是否关闭自己的 fd
+        int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d failed, errno:%d", fd, errno);
+            return;
+        }
+        if (loop_->isInLoopThread())
+        {
+            sendFileInLoop(fileFd, offset, length);
+        }
+        else
+        {
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, fileFd, offset, length]() {
+                conn->sendFileInLoop(fileFd, offset, length);
+            });
+        }
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up sending file!");
+        ::close(fd);
+        return;
+    }
+
+    // 和 sendInLoop 一样, 前面没有排队的数据时先直接发送
+    if (!completionIo_ && !channel_.isWriting() && !hasPendingOutput())
+    {
+        while (length > 0)
+        {
+            ssize_t n = ::sendfile(channel_.fd(), fd, &offset, length);
+            if (n <= 0)
+            {
+                if (n < 0 && errno != EAGAIN)
+                {
+                    LOG_ERROR("TcpConnection::sendFileInLoop");
+                }
+                break; // 剩下的交给 handleWrite, 由它统一处理错误和文件被截断的情况
+            }
+            length -= n;
+        }
+        if (length == 0)
+        {
+            ::close(fd);
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+            return;
+        }
+    }
+
+    checkHighWaterMark(length);
+    PendingFile file;
+    file.fd = fd;
+    file.offset = offset;
+    file.remaining = length;
+    file.after.setChunked(true);
+    pendingFiles_.push_back(std::move(file));
+    pendingFileBytes_ += length;
+    checkBackpressure();
+
+    if (completionIo_)
+    {
+        if (!sendInFlight_)
+        {
+            startSend();
+        }
+    }
+    else if (!channel_.isWriting())
+    {
+        channel_.enableWriting();
+    }
+}
+
+void TcpConnection::finishPendingFile()
+{
+    PendingFile &file = pendingFiles_.front();
+    ::close(file.fd);
+    outputBuffer_.swap(file.after); // 此时 outputBuffer_ 一定是空的
+    pendingFiles_.pop_front();
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    if (!reading_)
+    {
+        reading_ = true;
+        updateReadInterest();
+    }
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if (reading_)
+    {
+        reading_ = false;
+        updateReadInterest();
+    }
+}
+
+void TcpConnection::updateReadInterest()
+{
+    // 还没有建立(connectEstablished 会开启读取)或者已经关闭的连接不需要处理
+    if (state_ == kConnecting || state_ == kDisconnected)
+    {
+        return;
+    }
+    bool enable = readEnabled();
+    if (completionIo_)
+    {
+        // 完成式收发只要不再提交 recv 即可, 已经提交的 recv 完成后不会再续上
+        if (enable && !recvInFlight_)
+        {
+            startRecv();
+        }
+    }
+    else if (enable && !channel_.isReading())
+    {
+        channel_.enableReading();
+        if (edgeTriggered_)
+        {
+            // 暂停期间到达的数据不会再产生边缘通知, 主动读一次
+            continueReadInNextLoop(loop_->cachedNow());
+        }
+    }
+    else if (!enable && channel_.isReading())
+    {
+        channel_.disableReading();
+    }
+}
+
+void TcpConnection::setBackpressureSource(const TcpConnectionPtr &source, size_t highWaterMark)
+{
+    releaseBackpressure();
+    backpressureSource_ = source;
+    backpressureMark_ = source ? highWaterMark : 0;
+    checkBackpressure();
+}
+
+void TcpConnection::pairBackpressure(const TcpConnectionPtr &a, const TcpConnectionPtr &b, size_t highWaterMark)
+{
+    a->setBackpressureSource(b, highWaterMark);
+    b->setBackpressureSource(a, highWaterMark);
+}
+
+void TcpConnection::checkBackpressure()
+{
+    if (backpressureMark_ > 0 && !backpressureApplied_ && pendingOutputBytes() >= backpressureMark_)
+    {
+        TcpConnectionPtr source = backpressureSource_.lock();
+        if (source)
+        {
+            backpressureApplied_ = true;
+            source->stopRead();
+        }
+    }
+}
+
+void TcpConnection::releaseBackpressure()
+{
+    if (backpressureApplied_)
+    {
+        backpressureApplied_ = false;
+        TcpConnectionPtr source = backpressureSource_.lock();
+        if (source)
+        {
+            source->startRead();
+        }
+    }
+}
+
+void TcpConnection::setSocketBusyPoll(int microseconds)
+{
+    socket_.setBusyPoll(microseconds);
+}
+
+/**
+ * @brief 【线程安全的公有接口】关闭连接 (半关闭)。
+ * @details
+ * "半关闭"是指关闭本端的写通道, 但仍然可以接收数据。
+ * 这是实现优雅关闭(graceful shutdown)的标准做法。
+ */
+void TcpConnection::shutdown()
+{
+    if (state_ == kConnected)
+    {
+        setState(kDisconnecting); // 进入“正在关闭”状态
+        // 同样, 将实际操作派发给IO线程执行
+        loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+    }
+}
+
+/**
+ * @brief 【非线程安全的私有实现】在IO线程中执行的实际关闭逻辑。
+ */
+void TcpConnection::shutdownInLoop()
+{
+    // 只有当输出缓冲区的数据全部发送完毕后, 才能关闭写端。
+    // 如果还在监听可写事件, 说明数据还没发完, handleWrite会接管关闭流程。
+    if (!channel_.isWriting() && !sendInFlight_)
+    {
+        socket_.shutdownWrite(); // 调用底层的 shutdown(SHUT_WR)
+    }
+}
+
+/**
+ * @brief 【线程安全的公有接口】强制关闭连接。
+ * @details
+ * 与 shutdown() 不同, 它不会等待输出缓冲区中的数据发送完毕。
+ * 使用 queueInLoop 并捕获 shared_ptr, 保证即使在其他回调中调用, 连接也会在下一轮循环中安全关闭。
+ */
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+/**
+ * @brief 【非线程安全的私有实现】在IO线程中执行的强制关闭逻辑。
+ */
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+/**
+ * @brief 【非线程安全】当连接成功建立后, 在其所属的IO线程中被调用。
+ * @details
+ * 这是连接生命周期的“正式开始”。
+ */
+void TcpConnection::connectEstablished()
+{
+    setState(kConnected); // 设置状态为“已连接”
+    // 【核心安全机制】将 Channel 与 TcpConnection 的 shared_ptr 绑定。
+    // 这确保了即使上层(TcpServer)已经释放了对这个TcpConnection的shared_ptr,
+    // 只要Channel还活着(还在Poller的监听列表里), 这个TcpConnection对象就不会被析构。
+    channel_.tie(shared_from_this());
+
+    completionIo_ = completionIoRequested_ && loop_->ioUringPoller() != nullptr;
+    if (completionIo_)
+    {
+        startRecv(); // 完成式收发: 不监听读事件, 直接提交一个异步 recv
+    }
+    else
+    {
+        edgeTriggered_ = edgeTriggeredRequested_ && loop_->edgeTriggeredSupported();
+        if (edgeTriggered_)
+        {
+            channel_.enableEdgeTriggered();
+        }
+        zeroCopy_ = zeroCopyThreshold_ > 0 && socket_.setZeroCopy(true);
+        channel_.enableReading(); // 正式开始监听读事件
+    }
+
+    if (idleWheel_)
+    {
+        idleWheel_->add(&idleEntry_, shared_from_this()); // 开始空闲检测
+    }
+
+    // 执行用户设置的连接建立回调
+    connectionCallback_(shared_from_this());
+}
+
+/**
+ * @brief 【非线程安全】当连接被销毁前, 在其所属的IO线程中被调用。
+ * @details
+ * 这是连接生命周期的“最终清理”。
+ */
+void TcpConnection::connectDestroyed()
+{
+    if (state_ == kConnected)
+    {
+        setState(kDisconnected);
+        channel_.disableAll();                  // 停止所有事件监听
+        connectionCallback_(shared_from_this()); // 执行用户设置的连接断开回调
+    }
+    // 例如 TcpServer 析构时连接处于 kDisconnecting, 也要保证撤销的收发完成时被直接忽略
+    setState(kDisconnected);
+    cancelInFlightOperations();
+    releaseMemoryUsage();
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
+    channel_.remove(); // 将 Channel 从 Poller 中彻底移除
+}
+
+/**
+ * @brief 【非线程安全】Channel 的读事件回调, 由 EventLoop 触发
+ */
+void TcpConnection::handleRead(Timestamp receiveTime)
+{
+    int savedErrno = 0;
+    size_t total = 0;
+    ssize_t n = 0;
+    int syscalls = 0;
+    char *arena = loop_->readArena();
+    // 从 socket 读取数据到 inputBuffer_, 读到短读、EAGAIN 或者用完预算为止。
+    // 边缘触发时短读之后还要再读一次确认 EAGAIN(对端的 FIN 可能紧跟在数据后面), 否则不会再收到通知
+    do
+    {
+        inputBuffer_.ensureWritableBytes(readSizeHint_);
+        savedErrno = 0;
+        int calls = 0;
+        n = inputBuffer_.readFd(channel_.fd(), &savedErrno, arena, EventLoop::kReadArenaSize,
+                                readBudget_ - total, &calls);
+        syscalls += calls;
+        if (n > 0)
+        {
+            total += n;
+        }
+    } while (edgeTriggered_ && n > 0 && savedErrno == 0 && total < readBudget_);
+    loop_->recordRead(total, syscalls);
+
+    if (total > 0) // 成功读取到数据
+    {
+        adjustReadSize(total / syscalls);
+        if (idleWheel_)
+        {
+            idleWheel_->touch(&idleEntry_); // 有数据到来, 连接重新计时
+        }
+        // 调用用户的消息回调, 将数据和时间戳交给用户处理
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        checkInputLimit();
+    }
+
+    if (n > 0)
+    {
+        // 水平触发时, 没读完的数据或者读到数据之后遇到的 EOF/错误会被 Poller 再次通知。
+        // 边缘触发时不会, 预算用完或者还有未处理的错误都要自己在下一轮继续读
+        if (!edgeTriggered_ || savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+        {
+            return;
+        }
+        continueReadInNextLoop(receiveTime);
+    }
+    else if (n == 0) // read 返回0, 表示对端已正常关闭连接
+    {
+        if (state_ != kDisconnected)
+        {
+            handleClose();
+        }
+    }
+    else if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+    {
+        // 数据已经读完, 是正常情况
+    }
+    else // n < 0, 表示出错
+    {
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::handleRead");
+        handleError();
+    }
+}
+
+void TcpConnection::continueReadInNextLoop(Timestamp receiveTime)
+{
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->queueInLoop([conn, receiveTime]() {
+        if (conn->state_ != kDisconnected && conn->channel_.isReading())
+        {
+            conn->handleRead(receiveTime);
+        }
+    });
+}
+
+/**
+ * @brief 【非线程安全】Channel 的写事件回调, 由 EventLoop 触发
+ */
+void TcpConnection::handleWrite()
+{
+    if (channel_.isWriting()) // 确保仍在监听写事件
+    {
+        ssize_t n = 0;
+        size_t written = 0;
+        int savedErrno = 0;
+        // 按顺序发送 outputBuffer_(一次 writev 发送多个块)和排队的文件区间(sendfile)。
+        // 一段数据全部写完说明 socket 可能还有空间, 接着写下一段; 边缘触发时要一直写到 EAGAIN 或者写完为止
+        while (hasPendingOutput() && written < kEdgeTriggeredBudget)
+        {
+            size_t attempted = 0;
+            if (outputBuffer_.readableBytes() > 0)
+            {
+                attempted = outputBuffer_.readableBytes();
+                if (zeroCopy_ && attempted >= zeroCopyThreshold_)
+                {
+                    n = sendZeroCopy(&savedErrno, &attempted);
+                }
+                else
+                {
+                    n = outputBuffer_.writeFd(channel_.fd(), &savedErrno);
+                }
+                if (n > 0)
+                {
+                    outputBuffer_.retrieve(n); // 从缓冲区消耗掉已发送的数据
+                }
+            }
+            else
+            {
+                PendingFile &file = pendingFiles_.front();
+                if (file.remaining == 0)
+                {
+                    finishPendingFile();
+                    continue;
+                }
+                attempted = file.remaining;
+                n = ::sendfile(channel_.fd(), file.fd, &file.offset, file.remaining);
+                if (n > 0)
+                {
+                    file.remaining -= n;
+                    pendingFileBytes_ -= n;
+                }
+                else if (n == 0)
+                {
+                    // 文件比声明的短(发送期间被截断), 字节流已经无法按约定继续, 只能关闭连接
+                    LOG_ERROR("TcpConnection::handleWrite file truncated, %zu bytes missing", file.remaining);
+                    forceClose();
+                    return;
+                }
+                else
+                {
+                    savedErrno = errno;
+                }
+            }
+            if (n <= 0)
+            {
+                break;
+            }
+            written += n;
+            if (!edgeTriggered_ && static_cast<size_t>(n) < attempted)
+            {
+                break; // 水平触发时部分写入说明 socket 已满, 等下一次可写事件
+            }
+        }
+
+        updateMemoryUsage();
+        if (!hasPendingOutput()) // 如果数据已全部发送完毕
+        {
+            // 【核心】必须停止监听写事件, 否则会因为socket一直可写而导致此回调被不停触发, 造成CPU 100% (busy-loop)。
+            channel_.disableWriting();
+            releaseBackpressure();
+
+            if (writeCompleteCallback_)
+            {
+                // 调用用户的写完成回调, 通知用户数据已发完
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+
+            // 如果当前状态是“正在关闭”, 那么在数据发完后, 执行半关闭
+            if (state_ == kDisconnecting)
+            {
+                shutdownInLoop();
+            }
+        }
+        else if (edgeTriggered_ && n > 0) // 只有边缘触发且用完了预算才会走到这里, 下一轮循环继续写
+        {
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->queueInLoop([conn]() {
+                if (conn->state_ != kDisconnected && conn->channel_.isWriting())
+                {
+                    conn->handleWrite();
+                }
+            });
+        }
+        if (n < 0 && savedErrno != EWOULDBLOCK)
+        {
+            errno = savedErrno;
+            LOG_ERROR("TcpConnection::handleWrite failed, errno:%d", savedErrno);
+        }
+    }
+    else
+    {
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing", channel_.fd());
+    }
+}
+
+/**
+ * @brief 【非线程安全】Channel 的关闭事件回调, 或由 handleRead 调用
+ * @details
+ * 这是连接关闭的中央处理函数, 负责状态转换和回调通知。
+ */
+void TcpConnection::handleClose()
+{
+    setState(kDisconnected);
+    channel_.disableAll(); // 停止监听任何事件
+    cancelInFlightOperations();
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
+    releaseMemoryUsage();
+    releaseBackpressure();
+
+    TcpConnectionPtr connPtr(shared_from_this());
+    // 执行用户的连接回调 (表示连接已断开)
+    connectionCallback_(connPtr);
+    // 【核心】执行TcpServer设置的关闭回调, 其作用是通知TcpServer将自己从连接列表中移除。
+    closeCallback_(connPtr);
+}
+
+void TcpConnection::cancelInFlightOperations()
+{
+    // 回调持有本连接的 shared_ptr, 缓冲区在它执行之前一直有效
+    if (recvInFlight_)
+    {
+        loop_->ioUringPoller()->cancel(recvOperation_);
+    }
+    if (sendInFlight_)
+    {
+        loop_->ioUringPoller()->cancel(sendOperation_);
+    }
+}
+
+/**
+ * @brief 【非线程安全】Channel 的错误事件回调
+ */
+void TcpConnection::handleError()
+{
+    // 零拷贝的完成通知通过 socket 的错误队列送达, 同样表现为 EPOLLERR
+    int reaped = zeroCopySendCount_ > 0 ? reapZeroCopy() : 0;
+    int optval;
+    socklen_t optlen = static_cast<socklen_t>(sizeof optval);
+    int err = 0;
+    // 使用 getsockopt(SO_ERROR) 获取底层的 socket 错误码, 这是处理socket异步错误的標準方法
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        err = errno;
+    }
+    else
+    {
+        err = optval;
+    }
+    if (reaped > 0 && err == 0)
+    {
+        return; // 只是零拷贝的完成通知
+    }
+    LOG_ERROR("TcpConnection::handleError name:[%s] - SO_ERROR = %d", name().c_str(), err);
+}
+
+ssize_t TcpConnection::sendZeroCopy(int *savedErrno, size_t *attempted)
+{
+    struct iovec iov[kMaxSendIov];
+    int count = outputBuffer_.peekIovec(iov, kMaxSendIov);
+    *attempted = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        *attempted += iov[i].iov_len;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    ssize_t n = ::sendmsg(channel_.fd(), &msg, MSG_ZEROCOPY);
+    if (n > 0)
+    {
+        // 内核在完成通知之前一直引用这些内存, 持有它们所在的块, 防止被复用或还给池
+        ZeroCopySend send;
+        send.seq = zeroCopyNextSeq_++;
+        outputBuffer_.retainFront(n, &send.owners);
+        zeroCopyPending_.push_back(std::move(send));
+        ++zeroCopySendCount_;
+    }
+    else if (n < 0 && errno == ENOBUFS)
+    {
+        // 锁定的页面超出了 optmem 限制, 这一次改用普通发送
+        n = outputBuffer_.writeFd(channel_.fd(), savedErrno);
+    }
+    else if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    return n;
+}
+
+int TcpConnection::reapZeroCopy()
+{
+    int reaped = 0;
+    char control[128];
+    while (true)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(channel_.fd(), &msg, MSG_ERRQUEUE) < 0)
+        {
+            break; // EAGAIN: 错误队列已经取空
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+            const struct sock_extended_err *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+            {
+                continue;
+            }
+            // 一条通知覆盖编号 [ee_info, ee_data] 的所有发送, TCP 上它们总是按顺序完成
+            uint32_t last = serr->ee_data;
+            while (!zeroCopyPending_.empty() && static_cast<int32_t>(zeroCopyPending_.front().seq - last) <= 0)
+            {
+                zeroCopyPending_.pop_front();
+            }
+            uint32_t count = last - serr->ee_info + 1;
+            reaped += count;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                // 内核最终还是拷贝了数据(例如回环接口或网卡不支持), 零拷贝只剩下额外开销
+                zeroCopyCopiedCount_ += count;
+                zeroCopyCopiedStreak_ += count;
+                if (zeroCopy_ && zeroCopyCopiedStreak_ >= kZeroCopyCopiedLimit)
+                {
+                    zeroCopy_ = false;
+                    LOG_INFO("TcpConnection[%s] kernel keeps copying, fall back from MSG_ZEROCOPY", name().c_str());
+                }
+            }
+            else
+            {
+                zeroCopyCopiedStreak_ = 0;
+            }
+        }
+    }
+    return reaped;
+}
+
+void TcpConnection::adjustReadSize(size_t bytesPerRead)
+{
+    if (bytesPerRead >= readSizeHint_)
+    {
+        readSizeHint_ = std::min(readSizeHint_ * 2, kMaxReadSize);
+        readShrinkPending_ = false;
+    }
+    else if (bytesPerRead < readSizeHint_ / 2)
+    {
+        if (readShrinkPending_)
+        {
+            readSizeHint_ = std::max(readSizeHint_ / 2, kMinReadSize);
+        }
+        readShrinkPending_ = !readShrinkPending_;
+    }
+    else
+    {
+        readShrinkPending_ = false;
+    }
+}
+
+void TcpConnection::startRecv()
+{
+    inputBuffer_.ensureWritableBytes(readSizeHint_);
+    TcpConnectionPtr conn(shared_from_this());
+    recvOperation_ = loop_->ioUringPoller()->submitRecv(
+        channel_.fd(), inputBuffer_.beginWrite(), inputBuffer_.writableBytes(),
+        [conn](int res) { conn->handleRecvComplete(res); });
+    recvInFlight_ = true;
+}
+
+/**
+ * @brief 【非线程安全】异步 recv 完成, 相当于就绪模式下的 handleRead
+ */
+void TcpConnection::handleRecvComplete(int res)
+{
+    recvInFlight_ = false;
+    if (state_ == kDisconnected)
+    {
+        return; // 连接已经关闭, 这是被撤销的请求
+    }
+
+    if (res > 0)
+    {
+        inputBuffer_.hasWritten(res);
+        loop_->recordRead(res, 1);
+        adjustReadSize(res);
+        if (idleWheel_)
+        {
+            idleWheel_->touch(&idleEntry_);
+        }
+        messageCallback_(shared_from_this(), &inputBuffer_, loop_->cachedNow());
+        checkInputLimit();
+        if (state_ != kDisconnected && readEnabled())
+        {
+            startRecv();
+        }
+    }
+    else if (res == 0)
+    {
+        handleClose();
+    }
+    else
+    {
+        errno = -res;
+        LOG_ERROR("TcpConnection::handleRecvComplete");
+        handleError();
+        // 完成式收发没有 EPOLLHUP 可等, 出错后直接关闭
+        handleClose();
+    }
+}
+
+bool TcpConnection::startSend()
+{
+    // 当前没有进行中的发送, 把 outputBuffer_ 整体换出来交给内核, 之后的新数据继续追加到 outputBuffer_。
+    // outputBuffer_ 为空时轮到排队的文件: io_uring 这里没有 sendfile, 每次 pread 一块再异步发送
+    while (sendingBuffer_.readableBytes() == 0)
+    {
+        if (outputBuffer_.readableBytes() > 0)
+        {
+            sendingBuffer_.swap(outputBuffer_);
+        }
+        else if (pendingFiles_.empty())
+        {
+            return false;
+        }
+        else if (pendingFiles_.front().remaining == 0)
+        {
+            finishPendingFile();
+        }
+        else
+        {
+            PendingFile &file = pendingFiles_.front();
+            size_t len = std::min(file.remaining, kFileReadChunk);
+            sendingBuffer_.ensureWritableBytes(len);
+            ssize_t n = ::pread(file.fd, sendingBuffer_.beginWrite(), len, file.offset);
+            if (n <= 0)
+            {
+                LOG_ERROR("TcpConnection::startSend read file failed, errno:%d", n < 0 ? errno : 0);
+                forceClose();
+                return false;
+            }
+            sendingBuffer_.hasWritten(n);
+            file.offset += n;
+            file.remaining -= n;
+            pendingFileBytes_ -= n;
+        }
+    }
+    // 一次异步 send 发送第一个块, 剩下的在完成回调里继续
+    struct iovec iov;
+    sendingBuffer_.peekIovec(&iov, 1);
+    TcpConnectionPtr conn(shared_from_this());
+    sendOperation_ = loop_->ioUringPoller()->submitSend(
+        channel_.fd(), iov.iov_base, iov.iov_len,
+        [conn](int res) { conn->handleSendComplete(res); });
+    sendInFlight_ = true;
+    return true;
+}
+
+/**
+ * @brief 【非线程安全】异步 send 完成, 相当于就绪模式下的 handleWrite
+ */
+void TcpConnection::handleSendComplete(int res)
+{
+    sendInFlight_ = false;
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+
+    if (res < 0)
+    {
+        // 对端重置等错误交给 recv 一侧发现并关闭连接; 因为内存预算暂停了读取时没有 recv, 直接关闭
+        errno = -res;
+        LOG_ERROR("TcpConnection::handleSendComplete failed, errno:%d", -res);
+        if (!recvInFlight_)
+        {
+            handleClose();
+        }
+        return;
+    }
+
+    sendingBuffer_.retrieve(res);
+    updateMemoryUsage();
+    // 继续发送没发完的部分、期间追加的新数据或者排队的文件
+    if (!startSend())
+    {
+        releaseBackpressure();
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+}
@@ -4,15 +4,23 @@
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "SharedPayload.h"
+#include "MemoryBudget.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
+#include "Socket.h"
+#include "Channel.h"
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <atomic>
+#include <deque>
+#include <mutex> // for std::once_flag
+#include <sys/types.h>
+#include <sys/uio.h>
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * @brief TcpConnection 是对一个已建立的TCP连接的封装。
@@ -22,6 +30,8 @@ class Socket;
  * 它负责数据的收发, 并将收到的数据(通过MessageCallback)和连接状态的变化
  * (通过ConnectionCallback)通知给上层业务逻辑。
  * 这个类的对象生命周期由 std::shared_ptr 管理, 确保了在异步回调中的安全性。
+ * Socket 和 Channel 直接作为成员, TcpServer 用 allocate_shared 从池中分配(见 ObjectPool.h),
+ * 一个连接连同 shared_ptr 的控制块只占一个内存块。
  */
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
@@ -38,13 +48,15 @@ public:
     /**
      * @brief 构造函数。
      * @param loop TcpConnection 所属的 EventLoop (一个 subLoop)。
-     * @param name 连接的名称。
+     * @param id 连接的编号, 高32位是服务器内的连接序号, 低32位由 TcpServer 自行使用。
+     * @param namePrefix 名称前缀(服务器名和监听地址), 多个连接共享同一个字符串。
      * @param sockfd Acceptor 接受的新连接的 socket fd。
      * @param localAddr 服务器本地的地址信息。
      * @param peerAddr 客户端对端的地址信息。
      */
     TcpConnection(EventLoop *loop,
-                  const std::string &name, // 建议使用 const std::string&
+                  uint64_t id,
+                  std::shared_ptr<const std::string> namePrefix,
                   int sockfd,
                   const InetAddress &localAddr,
                   const InetAddress &peerAddr);
@@ -57,7 +69,13 @@ public:
 
     // --- 提供给外部查询状态的接口 ---
     EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
+    uint64_t id() const { return id_; }
+    /**
+     * @brief 连接的名称, 形如 "服务器名-ip:port#序号"。
+     * @details 只用于日志, 第一次调用时才生成, 大部分连接从头到尾都不需要它。
+     * @note 线程安全。
+     */
+    const std::string &name() const;
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
     bool connected() const { return state_ == kConnected; }
@@ -75,6 +93,47 @@ public:
     // (可选，但推荐) 增加一个右值引用版本，提高效率
     void send(std::string &&buf);
 
+    /**
+     * @brief 发送一段不属于连接的数据。
+     * @details IO线程中调用时数据只会在发不完时被拷贝一次; 其他线程调用时拷贝一次后派发到IO线程。
+     * @note 这是一个线程安全的操作。
+     */
+    void send(std::string_view message);
+    void send(const char *message) { send(std::string_view(message)); }
+
+    /**
+     * @brief 发送 buf 中的全部可读数据, buf 随后为空。
+     * @details 数据块被直接接管(见 Buffer::append(Buffer*)), 不会拷贝, 跨线程时也一样。
+     * @note 这是一个线程安全的操作, 但调用期间 buf 不能被其他线程访问。
+     */
+    void send(Buffer *buf);
+
+    /**
+     * @brief 按顺序发送多段数据, 相当于把它们拼接起来再 send(), 但不需要拼接。
+     * @details 可以直接发送时用一次 writev 发出, 发不完的部分逐段追加到输出缓冲区。
+     * 例如协议头和消息体分别存放时, 不必先拼成一个临时字符串。
+     * @note 这是一个线程安全的操作。其他线程调用时所有片段会被拷贝一次。
+     */
+    void sendv(const struct iovec *iov, int iovcnt);
+
+    /**
+     * @brief 发送一份共享的消息内容。
+     * @details 发不完的部分以只读块的形式挂进输出缓冲区, 不会拷贝; 跨线程时也只是增加引用计数。
+     * 适合把同一条消息发给大量连接(见 TcpServer::broadcast)。
+     * @note 这是一个线程安全的操作。
+     */
+    void send(const SharedPayload &payload);
+
+    /**
+     * @brief 发送文件 fd 中从 offset 开始的 length 字节, 数据由内核直接从页缓存发出(sendfile), 不经过用户态。
+     * @details
+     * 文件区间和 send() 的数据按调用顺序排队, 尚未发出的字节同样计入高水位标记。
+     * fd 会被 dup 一份, 调用返回后调用方可以立即关闭自己的 fd; 文件在发送期间不应被截断,
+     * 否则连接会被关闭。使用完成式收发的连接没有 sendfile 可用, 改为分块 pread 之后异步 send。
+     * @note 这是一个线程安全的操作。
+     */
+    void sendFile(int fd, off_t offset, size_t length);
+
     /**
      * @brief 关闭连接 (优雅关闭)。
      * @details
@@ -84,6 +143,119 @@ public:
      */
     void shutdown();
 
+    /**
+     * @brief 强制关闭连接。
+     * @details 不等待输出缓冲区发送完毕, 直接走 handleClose() 的关闭流程。
+     * 用于踢掉空闲或异常的连接。
+     * @note 这是一个线程安全的操作。
+     */
+    void forceClose();
+
+    /**
+     * @brief 恢复/暂停读取这个连接, 用于读取一侧的流量控制。
+     * @details
+     * 暂停期间不再从 socket 读取数据, 数据留在内核接收缓冲区中, 最终通过 TCP 窗口让对端减速。
+     * 完成式收发时已经提交的 recv 仍会完成一次, 之后不再提交新的 recv。
+     * 与内存预算导致的暂停相互独立, 两者都允许时才会读取。
+     * @note 这是一个线程安全的操作, 实际操作在IO线程中执行。
+     */
+    void startRead();
+    void stopRead();
+    /// @brief 用户是否允许读取(没有调用 stopRead())
+    bool isReading() const { return reading_; }
+
+    /**
+     * @brief 设置读取一侧的反压: 本连接待发送的数据超过 highWaterMark 时暂停读取 source,
+     * 本连接的数据全部发完(写完成)后恢复。
+     * @details
+     * 用于代理: 从快速的上游读到的数据转发给慢速的客户端时, 把上游设置为客户端的 source,
+     * 数据就会留在上游的内核缓冲区里, 而不是堆积在客户端的 outputBuffer_ 中, 代理的内存保持平稳。
+     * 只持有 source 的弱引用。本连接关闭时, 如果 source 正被暂停则恢复它。
+     * @param source 为空表示取消反压。
+     * @note 只能在IO线程中调用(例如在连接回调中), source 可以属于其他 loop。
+     */
+    void setBackpressureSource(const TcpConnectionPtr &source, size_t highWaterMark);
+
+    /**
+     * @brief 把两个连接配成一对, 双向设置反压(见 setBackpressureSource), 适用于双向转发的隧道。
+     * @note 两个连接属于不同的 loop 时, 需要分别在各自的IO线程中调用 setBackpressureSource。
+     */
+    static void pairBackpressure(const TcpConnectionPtr &a, const TcpConnectionPtr &b, size_t highWaterMark);
+
+    /**
+     * @brief 设置空闲连接检测所使用的时间轮。
+     * @note 必须在 connectEstablished() 之前调用, 由 TcpServer 使用。
+     */
+    void setIdleTimingWheel(const std::shared_ptr<TimingWheel> &wheel) { idleWheel_ = wheel; }
+
+    /**
+     * @brief 选择使用 io_uring 的完成式收发, 代替“就绪通知 + read/write”。
+     * @details
+     * 开启后连接不再监听可读/可写事件, 而是始终保持一个异步 recv 在内核中,
+     * 发送时把 outputBuffer_ 整体交给一个异步 send, 所有请求随下一次 poll() 批量提交。
+     * 用户看到的回调语义不变。所属 loop 不是 io_uring 后端时此设置被忽略。
+     * @note 必须在 connectEstablished() 之前调用, 由 TcpServer 使用。
+     */
+    void setCompletionIo(bool on) { completionIoRequested_ = on; }
+
+    /**
+     * @brief 选择边缘触发模式。
+     * @details
+     * 开启后 fd 只在建立连接时注册一次(EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET),
+     * 部分写入后开始/停止关注可写事件都不再需要 epoll_ctl。
+     * handleRead/handleWrite 会一直读/写到 EAGAIN, 单次事件最多处理 readBudget_/kEdgeTriggeredBudget 字节,
+     * 预算用完时通过 queueInLoop 在下一轮循环中继续, 避免一个连接独占 IO 线程。
+     * 所属 loop 的 Poller 不支持边缘触发、或者开启了完成式收发时此设置被忽略。
+     * @note 必须在 connectEstablished() 之前调用, 由 TcpServer 使用。
+     */
+    void setEdgeTriggered(bool on) { edgeTriggeredRequested_ = on; }
+
+    /**
+     * @brief 在底层 socket 上开启 SO_BUSY_POLL, 配合 EventLoop::setBusyPoll 降低接收延迟。
+     * @param microseconds 忙等的最长时间(微秒), 0 表示关闭。
+     */
+    void setSocketBusyPoll(int microseconds);
+
+    /**
+     * @brief 设置单次读事件最多读取的字节数, 默认 256K。
+     * @details
+     * handleRead 会一直读到短读或 EAGAIN, 预算用完时留到下一轮循环(水平触发由 Poller 再次通知,
+     * 边缘触发通过 queueInLoop 继续), 避免一个高速连接独占 IO 线程。
+     * @note 只能在IO线程中调用, 或者在 connectEstablished() 之前由 TcpServer 设置。
+     */
+    void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+
+    /**
+     * @brief 为大块发送开启 MSG_ZEROCOPY, 内核直接引用用户内存而不是拷贝。
+     * @details
+     * 待发送的数据不少于 minBytes 时, handleWrite 用 sendmsg(MSG_ZEROCOPY) 发送 outputBuffer_ 中的块,
+     * 这些块在内核通过 socket 错误队列(EPOLLERR)通知发送完成之前一直被持有, 不会被复用;
+     * send(std::string&&) 发送大块数据时连拷贝进 outputBuffer_ 的那一次也省掉, 字符串本身被挂进缓冲区。
+     * 内核连续报告“仍然拷贝了”(例如走回环接口)时, 自动退回普通发送。
+     * 开启了完成式收发、或者内核不支持 SO_ZEROCOPY 时此设置被忽略。
+     * @param minBytes 使用零拷贝的最小字节数, 0 表示关闭。
+     * @note 必须在 connectEstablished() 之前调用, 由 TcpServer 使用。
+     */
+    void setZeroCopy(size_t minBytes) { zeroCopyThreshold_ = minBytes; }
+    /// @brief 是否正在使用零拷贝发送
+    bool zeroCopyActive() const { return zeroCopy_; }
+    /// @brief 以零拷贝方式调用 sendmsg 的次数
+    uint64_t zeroCopySendCount() const { return zeroCopySendCount_; }
+    /// @brief 内核报告实际仍然拷贝了的零拷贝发送次数
+    uint64_t zeroCopyCopiedCount() const { return zeroCopyCopiedCount_; }
+    /// @brief 当前自适应的直接读取大小(每次读取前在 inputBuffer_ 中预留的可写空间)
+    size_t readSizeHint() const { return readSizeHint_; }
+
+    /**
+     * @brief 设置缓冲区的内存预算(见 MemoryBudget), 为空表示不限制。
+     * @note 必须在 connectEstablished() 之前调用, 由 TcpServer 使用。
+     */
+    void setMemoryBudget(const std::shared_ptr<MemoryBudget> &budget) { memoryBudget_ = budget; }
+    /// @brief 本连接当前缓冲的字节数(输入缓冲区 + 待发送数据, 不含排队的文件), 只能在IO线程中读取
+    size_t bufferedBytes() const { return accountedBytes_; }
+    /// @brief 是否因为超出内存预算而暂停了读取
+    bool readPausedByBudget() const { return readPausedByBudget_; }
+
     // --- 用户回调函数的设置接口 ---
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
@@ -133,23 +305,121 @@ private:
      * @brief Channel 的关闭事件回调, 由 EventLoop::loop() 调用。
      */
     void handleClose();
+    /// @brief 撤销进行中的异步收发, 回调会在之后以 -ECANCELED 执行
+    void cancelInFlightOperations();
 
     /**
      * @brief Channel 的错误事件回调, 由 EventLoop::loop() 调用。
      */
     void handleError();
 
+    /**
+     * @brief 根据最近一次读取的大小调整 readSizeHint_。
+     * @details 读满预留空间说明来得更多, 立即加倍; 连续两次不到一半才减半, 避免来回抖动。
+     */
+    void adjustReadSize(size_t bytesPerRead);
+
+    /// @brief 提交一个异步 recv, 数据直接写入 inputBuffer_ 的可写区域
+    void startRecv();
+    /// @brief 异步 recv 完成的回调, res 与 recv(2) 的返回值相同(失败时为负的errno)
+    void handleRecvComplete(int res);
+    /**
+     * @brief 把待发送的数据交给一个异步 send。
+     * @return bool 没有任何待发送的数据时返回 false。
+     */
+    bool startSend();
+    /// @brief 异步 send 完成的回调
+    void handleSendComplete(int res);
+
     /**
      * @brief send() 的线程安全实现。它将实际的发送操作派发到IO线程执行。
      */
     void sendInLoop(const void *message, size_t len);
     void sendInLoop(const std::string &message); // 增加一个string的重载
+    /// @brief 可以接管 message 的内存, 开启零拷贝时大块数据直接挂进缓冲区
+    void sendInLoop(std::string &&message);
+    void sendInLoop(Buffer *buf);
+    void sendvInLoop(const struct iovec *iov, int iovcnt);
+    void sendInLoop(const SharedPayload &payload);
+    /**
+     * @brief 各个 sendInLoop 共用的直接发送: 前面没有排队的数据时立即写入 socket。
+     * @param total 本次要发送的总字节数, 全部写出时触发写完成回调。
+     * @return ssize_t 已经写出的字节数; -1 表示连接已经出错, 剩下的数据不必再缓存。
+     */
+    ssize_t writeDirect(const struct iovec *iov, int iovcnt, size_t total);
+    /// @brief 新的待发送数据应该追加到的缓冲区: 有排队的文件时是最后一个文件的 after, 否则是 outputBuffer_
+    Buffer *outputTail() { return pendingFiles_.empty() ? &outputBuffer_ : &pendingFiles_.back().after; }
+    /// @brief 有数据追加到 outputTail() 之后, 开始监听可写事件或提交异步 send
+    void startOutput();
+    /// @brief 将要追加 adding 字节的待发送数据, 越过高水位时通知用户
+    void checkHighWaterMark(size_t adding);
+    /**
+     * @brief 检查追加 adding 字节待发送数据之后是否超出内存预算, 超出时执行预算的处理方式。
+     * @param partiallySent 这条消息是否已经写出了一部分, 是的话不能丢弃剩下的部分。
+     * @return bool 是否应该把数据放进缓冲区; 丢弃或者关闭连接时返回 false。
+     */
+    bool checkOutputLimit(size_t adding, bool partiallySent);
+    /// @brief 消息回调之后检查输入缓冲区和总用量是否超出内存预算
+    void checkInputLimit();
+    /// @brief 把当前缓冲的字节数与已经计入的值之差累加到 loop 和预算中, 并在用量回落后恢复读取
+    void updateMemoryUsage();
+    /// @brief 连接关闭时撤销本连接计入的全部用量
+    void releaseMemoryUsage();
+    /// @brief 是否应该读取: 用户没有 stopRead(), 也没有因为内存预算暂停
+    bool readEnabled() const { return reading_ && !readPausedByBudget_; }
+    /// @brief 按 readEnabled() 开启/关闭读取, 就绪模式修改 Channel, 完成式收发提交 recv
+    void updateReadInterest();
+    void startReadInLoop();
+    void stopReadInLoop();
+    /// @brief 待发送数据越过反压水位时暂停 source 的读取
+    void checkBackpressure();
+    /// @brief 待发送的数据已经全部发完, 或者连接关闭, 恢复 source 的读取
+    void releaseBackpressure();
+    /// @brief 因为超出预算暂停读取, 并定时检查是否可以恢复
+    void pauseReadingForBudget();
+    /// @brief 用量是否已经回落到可以恢复读取的程度
+    bool budgetAllowsReading() const;
+    /// @brief 在下一轮循环中继续读取(边缘触发时不会再收到已有数据的通知)
+    void continueReadInNextLoop(Timestamp receiveTime);
+    /// @brief sendFile() 在IO线程中的实现, fd 已经是 dup 出来的, 由本连接负责关闭
+    void sendFileInLoop(int fd, off_t offset, size_t length);
+
+    /// @brief 是否还有尚未交给内核的数据(outputBuffer_ 或排队的文件)
+    bool hasPendingOutput() const { return outputBuffer_.readableBytes() > 0 || !pendingFiles_.empty(); }
+    /// @brief 所有尚未发出的字节数, 用于高水位判断
+    size_t pendingOutputBytes() const
+    {
+        size_t bytes = outputBuffer_.readableBytes() + sendingBuffer_.readableBytes() + pendingFileBytes_;
+        for (const PendingFile &file : pendingFiles_)
+        {
+            bytes += file.after.readableBytes();
+        }
+        return bytes;
+    }
+    /// @brief 队首文件已经发完: 关闭它, 并把排在它后面的数据接到 outputBuffer_
+    void finishPendingFile();
+
+    /**
+     * @brief 用 sendmsg(MSG_ZEROCOPY) 发送 outputBuffer_ 开头的若干块, 并持有它们直到内核通知完成。
+     * @param attempted [输出参数] 本次尝试发送的字节数。
+     */
+    ssize_t sendZeroCopy(int *savedErrno, size_t *attempted);
+    /**
+     * @brief 从 socket 的错误队列中取出所有零拷贝完成通知, 释放对应的块。
+     * @return int 完成的发送次数。
+     */
+    int reapZeroCopy();
 
     /**
      * @brief shutdown() 的线程安全实现。它将实际的关闭操作派发到IO线程执行。
      */
     void shutdownInLoop();
 
+    /**
+     * @brief forceClose() 在IO线程中的实际执行函数。
+     */
+    void forceCloseInLoop();
+
     /**
      * @brief 设置当前连接的内部状态。
      * @details 这是 TcpConnection 内部驱动状态机使用的辅助函数，
@@ -162,17 +432,22 @@ private:
 
     /// @brief 所属的 EventLoop (subLoop)。
     EventLoop *loop_;
-    /// @brief 连接的唯一名称。
-    const std::string name_;
+    /// @brief 连接的编号
+    const uint64_t id_;
+    /// @brief 名称前缀, 由服务器的所有连接共享
+    std::shared_ptr<const std::string> namePrefix_;
+    /// @brief 连接的名称, 第一次调用 name() 时生成
+    mutable std::string name_;
+    mutable std::once_flag nameOnce_;
     /// @brief 连接的状态, 使用原子类型保证多线程下的可见性。
     std::atomic<StateE> state_;
-    // /// @brief 标识是否正在读取数据, 用于控制Channel的enableReading。
-    // bool reading_;
+    /// @brief 用户是否允许读取, 由 startRead()/stopRead() 控制
+    bool reading_;
 
-    /// @brief 底层的 socket 封装, unique_ptr 保证了资源的独占性和自动释放。
-    std::unique_ptr<Socket> socket_;
-    /// @brief 底层的 Channel 封装, unique_ptr 保证了资源的独占性和自动释放。
-    std::unique_ptr<Channel> channel_;
+    /// @brief 底层的 socket 封装, 析构时关闭 fd。必须在 channel_ 之前声明, 保证 fd 在 Channel 析构之后才关闭。
+    Socket socket_;
+    /// @brief 底层的 Channel 封装。
+    Channel channel_;
 
     /// @brief 服务器本地的地址。
     const InetAddress localAddr_;
@@ -194,6 +469,84 @@ private:
 
     /// @brief 输入(接收)缓冲区。
     Buffer inputBuffer_;
+    /// @brief 单次读事件最多读取的字节数
+    size_t readBudget_;
+    /// @brief 每次读取前在 inputBuffer_ 中预留的可写空间, 随最近的读取大小自适应
+    size_t readSizeHint_;
+    /// @brief 上一次读取是否已经不到 readSizeHint_ 的一半
+    bool readShrinkPending_;
     /// @brief 输出(发送)缓冲区。
     Buffer outputBuffer_;
+
+    /// @brief 用户是否要求使用边缘触发
+    bool edgeTriggeredRequested_;
+    /// @brief 实际是否使用边缘触发, 在 connectEstablished() 中确定
+    bool edgeTriggered_;
+    /// @brief 用户是否要求使用完成式收发
+    bool completionIoRequested_;
+    /// @brief 实际是否使用完成式收发, 在 connectEstablished() 中确定
+    bool completionIo_;
+    /// @brief 是否有异步 recv/send 正在进行, 以及它们的句柄(用于取消)
+    bool recvInFlight_;
+    bool sendInFlight_;
+    uint64_t recvOperation_;
+    uint64_t sendOperation_;
+    /// @brief 正在被异步 send 使用的数据。发送期间内核直接读取它, 新数据只能追加到 outputBuffer_。
+    Buffer sendingBuffer_;
+
+    /// @brief 一段排队等待发送的文件区间
+    struct PendingFile
+    {
+        /// @brief dup 出来的文件描述符, 发完或者连接析构时关闭
+        int fd;
+        off_t offset;
+        size_t remaining;
+        /// @brief 在这个文件之后 send() 的数据, 文件发完后才能发送
+        Buffer after;
+    };
+    /// @brief 排在 outputBuffer_ 之后的文件区间, 按调用顺序发送
+    std::deque<PendingFile> pendingFiles_;
+    /// @brief pendingFiles_ 中的文件尚未发出的字节数(不含各自的 after)
+    size_t pendingFileBytes_;
+
+    /// @brief 使用零拷贝的最小字节数, 0 表示未开启
+    size_t zeroCopyThreshold_;
+    /// @brief 当前是否使用零拷贝, 在 connectEstablished() 中确定, 内核总是拷贝时会被关闭
+    bool zeroCopy_;
+    /// @brief 一次零拷贝发送, 内核按调用顺序从0开始编号
+    struct ZeroCopySend
+    {
+        uint32_t seq;
+        /// @brief 这次发送引用的数据块, 收到完成通知后释放
+        std::vector<std::shared_ptr<void>> owners;
+    };
+    /// @brief 等待内核完成通知的零拷贝发送
+    std::deque<ZeroCopySend> zeroCopyPending_;
+    /// @brief 下一次零拷贝发送的编号
+    uint32_t zeroCopyNextSeq_;
+    /// @brief 连续报告“仍然拷贝了”的次数
+    int zeroCopyCopiedStreak_;
+    uint64_t zeroCopySendCount_;
+    uint64_t zeroCopyCopiedCount_;
+
+    /// @brief 内存预算, 为空表示不限制
+    std::shared_ptr<MemoryBudget> memoryBudget_;
+    /// @brief 已经计入 loop 和预算的缓冲字节数
+    size_t accountedBytes_;
+    /// @brief 是否因为超出内存预算暂停了读取
+    bool readPausedByBudget_;
+    /// @brief 是否已经安排了检查能否恢复读取的定时器
+    bool budgetRecheckScheduled_;
+
+    /// @brief 反压的数据来源, 本连接待发送的数据过多时暂停读取它
+    std::weak_ptr<TcpConnection> backpressureSource_;
+    /// @brief 反压水位, 0 表示未设置
+    size_t backpressureMark_;
+    /// @brief 当前是否已经暂停了 source 的读取
+    bool backpressureApplied_;
+
+    /// @brief 所属 loop 的空闲检测时间轮, 为空表示未开启空闲检测。
+    std::shared_ptr<TimingWheel> idleWheel_;
+    /// @brief 本连接在时间轮中的链表节点。
+    TimingWheel::Entry idleEntry_;
 };
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "ObjectPool.h"
 
 #include <functional>
+#include <future>
 #include <strings.h> // bzero in older systems
 
 /**
@@ -39,13 +41,23 @@ TcpServer::TcpServer(EventLoop *loop,
                      Option option)
     : loop_(checkLoopNotNull(loop)),                                   // 验证并保存mainLoop指针
       ipPort_(listenAddr.toIpPort()),                                  // 保存监听地址的字符串表示
+      listenAddr_(listenAddr),
       name_(nameArg),                                                  // 保存服务器名称
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)), // 创建Acceptor
+      connNamePrefix_(std::make_shared<const std::string>(name_ + "-" + ipPort_)),
+      acceptor_(new Acceptor(loop, listenAddr, option != kNoReusePort)), // 创建Acceptor
+      option_(option),
+      acceptBatch_(Acceptor::kDefaultAcceptBatch),
       threadPool_(new EventLoopThreadPool(loop, name_)),               // 创建IO线程池
       connectionCallback_(),                                           // 默认初始化连接回调
       messageCallback_(),                                              // 默认初始化消息回调
       started_(0),                                                     // 原子计数器, 用于防止start()被多次调用
-      nextConnId_(1)                                                   // 连接ID从1开始计数
+      nextConnId_(1),                                                  // 连接序号从1开始计数
+      idleTimeoutSeconds_(0),                                          // 默认不检测空闲连接
+      completionIo_(false),
+      edgeTriggered_(false),
+      socketBusyPollUs_(0),
+      readBudget_(0),
+      zeroCopyThreshold_(0)
 {
     // 【核心回调设置】
     // 将Acceptor的“新连接到来”事件, 绑定到TcpServer自己的newConnection方法上。
@@ -53,27 +65,63 @@ TcpServer::TcpServer(EventLoop *loop,
     // 这里使用std::bind将成员函数和this指针绑定, 并用占位符_1, _2来预留未来由Acceptor传入的参数位置。
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
                                                   std::placeholders::_1, std::placeholders::_2));
+    connections_[loop_].reset(new ConnectionShard);
 }
 
 TcpServer::~TcpServer()
 {
-    // 遍历服务器管理的所有连接
-    for (auto &item : connections_)
+    // 此时线程池尚未析构, 各个subLoop仍然存活, 可以安全地取消时间轮的定时器
+    for (auto &item : idleWheels_)
     {
-        // item.second 是一个 TcpConnectionPtr (shared_ptr)
+        item.second->stop();
+    }
+
+    // 每个I/O线程的 Acceptor 和连接表只能在该线程中访问, 而这些线程此时仍在运行,
+    // 所以把清理工作交给它们, 并等待完成, 之后它们不会再调用 newConnectionInLoop
+    if (!loopAcceptors_.empty())
+    {
+        std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            EventLoop *ioLoop = loops[i];
+            std::promise<void> done;
+            ioLoop->runInLoop([this, ioLoop, i, &done]() {
+                loopAcceptors_[i].reset();
+                destroyConnections(*connections_.at(ioLoop));
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+
+    // mainLoop 的连接表(kReusePortPerLoop 模式下为空)
+    destroyConnections(*connections_.at(loop_));
+}
+
+void TcpServer::destroyConnections(ConnectionShard &shard)
+{
+    // 遍历连接表中的所有连接
+    for (ConnectionSlot &slot : shard.slots)
+    {
+        if (!slot.conn)
+        {
+            continue;
+        }
         // 创建一个局部 TcpConnectionPtr 变量 conn, 延长该连接对象的生命周期,
-        // 防止在 conn->connectDestroyed() 调用期间, 连接对象因为map的清理而被意外销毁。
-        TcpConnectionPtr conn(item.second);
-        item.second.reset(); // 从 map 中释放对 conn 的引用
+        // 防止在 conn->connectDestroyed() 调用期间, 连接对象因为连接表的清理而被意外销毁。
+        TcpConnectionPtr conn(std::move(slot.conn)); // 从连接表中释放对 conn 的引用
 
         // 获取该连接所属的 subLoop
         EventLoop *ioLoop = conn->getLoop();
-        
+
         // 将连接的“最终清理”任务, 派发给它所属的 subLoop 线程去执行。
         // 这是为了保证线程安全, 因为 Channel 的移除等操作必须在它所属的 loop 中进行。
         ioLoop->runInLoop(
             std::bind(&TcpConnection::connectDestroyed, conn));
     }
+    shard.slots.clear();
+    shard.freeSlots.clear();
+    shard.numConnections = 0;
 }
 
 /**
@@ -86,6 +134,23 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setLoopSelector(LoopSelector::Strategy strategy)
+{
+    LOG_INFO("TcpServer [%s] loop selector: %s\n", name_.c_str(), LoopSelector::strategyName(strategy));
+    threadPool_->setLoopSelector(std::unique_ptr<LoopSelector>(LoopSelector::newSelector(strategy)));
+}
+
+void TcpServer::setLoopSelector(std::unique_ptr<LoopSelector> selector)
+{
+    threadPool_->setLoopSelector(std::move(selector));
+}
+
+void TcpServer::setAcceptBatch(int batch)
+{
+    acceptBatch_ = batch;
+    acceptor_->setAcceptBatch(batch);
+}
+
 /**
  * @brief 启动服务器, 开始监听端口。
  * @details 这是一个线程安全的操作, 内部通过原子变量保证只启动一次。
@@ -98,6 +163,39 @@ void TcpServer::start()
         // 1. 启动线程池。这会创建并运行所有subLoop线程, 它们将阻塞在自己的loop()中等待任务。
         threadPool_->start(threadInitCallback_);
 
+        // 为每个subLoop创建一个时间轮, 之后 idleWheels_ 只会被 mainLoop 读取
+        if (idleTimeoutSeconds_ > 0)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<TimingWheel> wheel = std::make_shared<TimingWheel>(ioLoop, idleTimeoutSeconds_);
+                wheel->start();
+                idleWheels_[ioLoop] = wheel;
+            }
+        }
+
+        // kReusePortPerLoop: 每个subLoop绑定自己的监听socket, 在自己的线程中listen和accept。
+        // mainLoop的acceptor_只是绑定了端口, 不会listen, 因此不参与内核的连接分配。
+        std::vector<EventLoop *> ioLoops = threadPool_->getAllLoops();
+        if (option_ == kReusePortPerLoop && ioLoops.front() != loop_)
+        {
+            // 先创建好所有的 Acceptor 和连接表再开始监听, 之后 I/O 线程只读它们
+            for (EventLoop *ioLoop : ioLoops)
+            {
+                connections_[ioLoop].reset(new ConnectionShard);
+                std::unique_ptr<Acceptor> acceptor(new Acceptor(ioLoop, listenAddr_, true));
+                acceptor->setAcceptBatch(acceptBatch_);
+                acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionInLoop, this, ioLoop,
+                                                             std::placeholders::_1, std::placeholders::_2));
+                loopAcceptors_.push_back(std::move(acceptor));
+            }
+            for (size_t i = 0; i < ioLoops.size(); ++i)
+            {
+                ioLoops[i]->runInLoop(std::bind(&Acceptor::listen, loopAcceptors_[i].get()));
+            }
+            return;
+        }
+
         // 2. 开启Acceptor的监听。acceptor_->listen()方法必须在mainLoop中执行。
         //    使用runInLoop可以保证即使start()是在其他线程被调用的, listen()也能安全地在mainLoop线程中执行。
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
@@ -112,32 +210,36 @@ void TcpServer::start()
  */
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
-    // 【因为TcpConnection还未完成, 函数体暂时为空】
-    // 这是一个临时的实现, 以便通过编译器的严格检查。
-    // (void)sockfd; 的写法是向编译器明确表示, 我知道这个参数存在, 但我暂时故意不用它。
-    // 这是消除 "-Wunused-parameter" 警告/错误的常用方法。
-    // (void)sockfd;
-    // (void)peerAddr;
-
-    /**
-     * 【未来的完整逻辑】
-     * 1. 从线程池中轮询一个subLoop: EventLoop* ioLoop = threadPool_->getNextLoop();
-     * 2. 为新连接创建一个唯一的名称。
-     * 3. 创建一个新的TcpConnection对象:
-     * TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-     * 4. 将TcpServer设置好的用户回调(connectionCallback_, messageCallback_)设置给这个新的conn。
-     * 5. 设置conn自己的关闭回调, 用于从TcpServer的map中移除自己: conn->setCloseCallback(...)。
-     * 6. 将新的conn添加到TcpServer的ConnectionMap中进行管理。
-     * 7. 调用ioLoop->runInLoop(), 在选中的subLoop线程中执行TcpConnection::connectEstablished。
-     */
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
-
-    LOG_INFO("TcpServer::connection [%s] - new connection [%s] from %s",
-             name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+    // 由 LoopSelector 选出 subLoop, 连接登记在 mainLoop 的连接表中, 具体的创建过程见 createConnection
+    EventLoop *ioLoop = threadPool_->getNextLoop(&peerAddr);
+    createConnection(*connections_.at(loop_), ioLoop, sockfd, peerAddr);
+}
+
+void TcpServer::newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    // 接受连接的线程就是服务它的线程, 连接表也属于这个线程
+    createConnection(*connections_.at(ioLoop), ioLoop, sockfd, peerAddr);
+}
+
+void TcpServer::createConnection(ConnectionShard &shard, EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    // 分配一个槽位, 连接编号 = 序号 << 32 | 槽位下标。名称只在需要时由 TcpConnection 生成
+    uint32_t index;
+    if (!shard.freeSlots.empty())
+    {
+        index = shard.freeSlots.back();
+        shard.freeSlots.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(shard.slots.size());
+        shard.slots.push_back(ConnectionSlot());
+    }
+    uint64_t seq = nextConnId_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t connId = (seq << 32) | index;
+
+    LOG_DEBUG("TcpServer::connection [%s] - new connection #%llu from %s",
+              name_.c_str(), static_cast<unsigned long long>(connId >> 32), peerAddr.toIpPort().c_str());
 
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
     sockaddr_in local;
@@ -149,16 +251,37 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     }
 
     InetAddress localAddr(local);
-    TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                            connName,
-                                            sockfd,
-                                            localAddr,
-                                            peerAddr));
-    connections_[connName] = conn;
+    // 连接对象和 shared_ptr 的控制块一起从接受连接的线程的池中分配, 在其他线程中释放时会还回这个池
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(PoolAllocator<TcpConnection>(),
+                                                                ioLoop,
+                                                                connId,
+                                                                connNamePrefix_,
+                                                                sockfd,
+                                                                localAddr,
+                                                                peerAddr);
+    shard.slots[index].conn = conn;
+    shard.slots[index].id = connId;
+    ++shard.numConnections;
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (idleTimeoutSeconds_ > 0)
+    {
+        conn->setIdleTimingWheel(idleWheels_.at(ioLoop));
+    }
+    conn->setCompletionIo(completionIo_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    if (socketBusyPollUs_ > 0)
+    {
+        conn->setSocketBusyPoll(socketBusyPollUs_);
+    }
+    if (readBudget_ > 0)
+    {
+        conn->setReadBudget(readBudget_);
+    }
+    conn->setZeroCopy(zeroCopyThreshold_);
+    conn->setMemoryBudget(memoryBudget_);
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
@@ -168,18 +291,64 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
         std::bind(&TcpConnection::connectEstablished, conn));
 }
 
+void TcpServer::broadcast(const SharedPayload &payload)
+{
+    // 每张连接表只能在它所属的 loop 中访问
+    for (const auto &item : connections_)
+    {
+        ConnectionShard *shard = item.second.get();
+        item.first->runInLoop([shard, payload]() {
+            std::vector<TcpConnectionPtr> conns;
+            conns.reserve(shard->numConnections);
+            for (const ConnectionSlot &slot : shard->slots)
+            {
+                if (slot.conn)
+                {
+                    conns.push_back(slot.conn);
+                }
+            }
+            broadcast(conns, payload);
+        });
+    }
+}
+
+void TcpServer::broadcast(const std::vector<TcpConnectionPtr> &conns, const SharedPayload &payload)
+{
+    std::unordered_map<EventLoop *, std::vector<TcpConnectionPtr>> groups;
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        groups[conn->getLoop()].push_back(conn);
+    }
+    for (auto &group : groups)
+    {
+        group.first->runInLoop([conns = std::move(group.second), payload]() {
+            for (const TcpConnectionPtr &conn : conns)
+            {
+                conn->send(payload);
+            }
+        });
+    }
+}
+
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(
+    shardLoop(conn)->runInLoop(
         std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-             name_.c_str(), conn->name().c_str());
+    LOG_DEBUG("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
+              name_.c_str(), conn->name().c_str());
 
-    connections_.erase(conn->name());
+    ConnectionShard &shard = *connections_.at(shardLoop(conn));
+    uint32_t index = static_cast<uint32_t>(conn->id());
+    if (index < shard.slots.size() && shard.slots[index].conn && shard.slots[index].id == conn->id())
+    {
+        shard.slots[index].conn.reset();
+        shard.freeSlots.push_back(index);
+        --shard.numConnections;
+    }
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn));
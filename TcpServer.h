@@ -8,12 +8,16 @@
 #include "Callbacks.h" // 引入上面定义的回调类型
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "SharedPayload.h"
+#include "MemoryBudget.h"
+#include "TimingWheel.h"
 
 #include <functional>
 #include <string>
 #include <atomic>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 /**
  * @brief 对外使用的服务器主类 TcpServer。
@@ -33,6 +37,12 @@ public:
     {
         kNoReusePort,
         kReusePort,
+        /**
+         * 每个 I/O 线程拥有自己的监听 socket(都开启 SO_REUSEPORT), 由内核把新连接分散到各个线程,
+         * 连接在接受它的线程中建立和服务, 不再经过 mainLoop 转交。
+         * 没有 I/O 线程时与 kReusePort 相同。
+         */
+        kReusePortPerLoop,
     };
 
     /**
@@ -83,6 +93,81 @@ public:
      */
     void setThreadNum(int numThreads);
 
+    /**
+     * @brief 设置为新连接选择 I/O 线程的策略(见 LoopSelector), 默认轮询。
+     * @note 必须在 start() 之前调用。kReusePortPerLoop 模式下连接由接受它的线程服务, 不使用这个策略。
+     */
+    void setLoopSelector(LoopSelector::Strategy strategy);
+    /// @brief 使用自定义的选择策略
+    void setLoopSelector(std::unique_ptr<LoopSelector> selector);
+
+    /**
+     * @brief 开启空闲连接检测。
+     * @param seconds 连接在多少秒内没有收到任何数据就会被强制关闭, 0 表示关闭检测(默认)。
+     * @note 必须在 start() 之前调用。每个 I/O 线程会拥有一个独立的时间轮。
+     */
+    void setIdleTimeout(int seconds) { idleTimeoutSeconds_ = seconds; }
+
+    /**
+     * @brief 让新建立的连接使用 io_uring 的完成式收发(见 TcpConnection::setCompletionIo)。
+     * @note 只有使用 io_uring 后端的 I/O 线程上的连接才会生效, 其余连接仍然使用就绪通知。
+     */
+    void setCompletionIo(bool on) { completionIo_ = on; }
+
+    /**
+     * @brief 让新建立的连接使用边缘触发模式(见 TcpConnection::setEdgeTriggered)。
+     */
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    /**
+     * @brief 在新建立的连接上开启 SO_BUSY_POLL(见 TcpConnection::setSocketBusyPoll)。
+     * @details 通常配合 I/O 线程的 EventLoop::setBusyPoll 一起使用(可以在线程初始化回调中设置)。
+     * @param microseconds 忙等的最长时间(微秒), 0 表示不设置。
+     */
+    void setSocketBusyPoll(int microseconds) { socketBusyPollUs_ = microseconds; }
+
+    /**
+     * @brief 设置新建立的连接单次读事件最多读取的字节数(见 TcpConnection::setReadBudget)。
+     * @param bytes 读取预算, 0 表示使用默认值。
+     */
+    void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+
+    /**
+     * @brief 设置 mainLoop 每次被唤醒时最多 accept 的连接数(见 Acceptor::setAcceptBatch)。
+     */
+    void setAcceptBatch(int batch);
+
+    /**
+     * @brief 让新建立的连接对大块数据使用 MSG_ZEROCOPY 发送(见 TcpConnection::setZeroCopy)。
+     * @param minBytes 使用零拷贝的最小字节数, 0 表示关闭。
+     */
+    void setZeroCopy(size_t minBytes) { zeroCopyThreshold_ = minBytes; }
+
+    /**
+     * @brief 设置连接缓冲区的内存预算(单个连接的输入/输出上限和总上限, 见 MemoryBudget)。
+     * @details 多个 TcpServer 可以共享同一个预算, 它们的连接合计受同一个总上限约束。
+     * 每个 I/O 线程当前缓冲的字节数可以通过 EventLoop::bufferedBytes() 读取。
+     * @note 必须在 start() 之前调用。
+     */
+    void setMemoryBudget(const std::shared_ptr<MemoryBudget> &budget) { memoryBudget_ = budget; }
+    const std::shared_ptr<MemoryBudget> &memoryBudget() const { return memoryBudget_; }
+
+    /**
+     * @brief 把同一份消息发送给当前所有的连接。
+     * @details 见下面的重载, 连接列表在 mainLoop 中取得。
+     * @note 线程安全。
+     */
+    void broadcast(const SharedPayload &payload);
+
+    /**
+     * @brief 把同一份消息发送给一组连接(例如某个主题的全部订阅者)。
+     * @details
+     * 按连接所属的 I/O 线程分组, 每个线程只投递一个任务, 在任务中依次发送,
+     * 而不是每个连接投递一个任务。消息内容只有一份, 不会为每个连接拷贝。
+     * @note 线程安全, 连接可以属于不同的服务器。
+     */
+    static void broadcast(const std::vector<TcpConnectionPtr> &conns, const SharedPayload &payload);
+
     /**
      * @brief 开启服务器监听。
      * @note 此函数必须在 loop() 之前被调用。
@@ -90,6 +175,34 @@ public:
     void start();
 
 private:
+    /**
+     * @brief 连接表中的一个槽位。
+     * @details 连接编号的低32位是槽位下标, 高32位是连接序号,
+     * 删除时比较完整的编号, 槽位被复用后旧的编号不会误删新连接。
+     */
+    struct ConnectionSlot
+    {
+        TcpConnectionPtr conn;
+        uint64_t id;
+    };
+
+    /**
+     * @brief 一张连接表, 只在它所属的 loop 中访问。
+     * @details 默认模式下只有 mainLoop 的一张表; kReusePortPerLoop 模式下每个 I/O 线程一张,
+     * 各线程接受和移除连接时互不加锁。
+     */
+    struct ConnectionShard
+    {
+        ConnectionShard() : numConnections(0) {}
+
+        /// @brief 按连接编号的低32位索引, 空槽位的 conn 为空
+        std::vector<ConnectionSlot> slots;
+        /// @brief 空闲的槽位下标
+        std::vector<uint32_t> freeSlots;
+        /// @brief 活动连接数
+        size_t numConnections;
+    };
+
     /**
      * @brief Acceptor 接受一个新连接后, 会调用这个函数。
      * @param sockfd 新连接的socket文件描述符。
@@ -98,6 +211,24 @@ private:
      */
     void newConnection(int sockfd, const InetAddress &peerAddr);
 
+    /**
+     * @brief kReusePortPerLoop 模式下 I/O 线程自己的 Acceptor 接受一个新连接后调用。
+     * @note 运行在 ioLoop 线程中, 连接也由这个线程服务。
+     */
+    void newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+
+    /**
+     * @brief 创建连接并登记到 shard 中, 然后在 ioLoop 中建立连接。
+     * @note 运行在 shard 所属的 loop 中。
+     */
+    void createConnection(ConnectionShard &shard, EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+
+    /// @brief 管理该连接的连接表所属的 loop
+    EventLoop *shardLoop(const TcpConnectionPtr &conn) const
+    {
+        return loopAcceptors_.empty() ? loop_ : conn->getLoop();
+    }
+
     /**
      * @brief 当一个 TcpConnection 关闭时, 会调用这个函数来从服务器中移除该连接。
      * @param conn 即将移除的 TcpConnection 的智能指针。
@@ -106,22 +237,32 @@ private:
     void removeConnection(const TcpConnectionPtr &conn);
 
     /**
-     * @brief removeConnection 的实际执行函数, 保证在 mainLoop 线程中执行。
+     * @brief removeConnection 的实际执行函数, 保证在连接表所属的 loop 中执行。
      * @param conn 即将移除的 TcpConnection 的智能指针。
      */
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
-    
-    /// @brief 用于存储所有活动连接的 map, key 是连接的名称, value 是连接的智能指针。
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+
+    /// @brief 关闭一张连接表中的所有连接, 在连接表所属的 loop 中调用。
+    static void destroyConnections(ConnectionShard &shard);
 
     /// @brief 用户传入的 mainLoop, 即主 Reactor。
     EventLoop *loop_;
     /// @brief 服务器的 IP:Port 字符串。
     const std::string ipPort_;
+    /// @brief 监听地址, kReusePortPerLoop 模式下每个I/O线程的 Acceptor 都绑定到这个地址。
+    const InetAddress listenAddr_;
     /// @brief 服务器的名称。
     const std::string name_;
+    /// @brief 连接名称的公共前缀 "服务器名-ip:port", 所有连接共享一份。
+    const std::shared_ptr<const std::string> connNamePrefix_;
     /// @brief Acceptor 对象, 用于接受新连接。其生命周期由 unique_ptr 管理。
     std::unique_ptr<Acceptor> acceptor_;
+    /// @brief kReusePortPerLoop 模式下每个 I/O 线程的 Acceptor, 在 start() 中创建。为空表示由 acceptor_ 接受所有连接。
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
+    /// @brief 用户选择的端口复用模式。
+    const Option option_;
+    /// @brief 每次唤醒最多 accept 的连接数。
+    int acceptBatch_;
     /// @brief I/O 线程池。其生命周期由 shared_ptr 管理。
     std::shared_ptr<EventLoopThreadPool> threadPool_;
 
@@ -137,8 +278,25 @@ private:
     /// @brief 原子整型, 标记服务器是否已启动。防止 start() 被多次调用。
     std::atomic_int started_;
 
-    /// @brief 用于为新连接生成唯一名称的计数器。
-    int nextConnId_;
-    /// @brief 存储所有活动连接的 map 实例。
-    ConnectionMap connections_;
+    /// @brief 连接序号计数器, 作为连接编号的高32位, 也是连接名称中的序号。多个 I/O 线程可能同时接受连接。
+    std::atomic<uint32_t> nextConnId_;
+    /// @brief 每个 loop 的连接表, key 是连接表所属的 loop。start() 之后只读。
+    std::unordered_map<EventLoop *, std::unique_ptr<ConnectionShard>> connections_;
+
+    /// @brief 空闲连接超时秒数, 0 表示不检测。
+    int idleTimeoutSeconds_;
+    /// @brief 每个 I/O 线程一个时间轮, start() 之后只读。
+    std::unordered_map<EventLoop *, std::shared_ptr<TimingWheel>> idleWheels_;
+    /// @brief 新连接是否使用完成式收发。
+    bool completionIo_;
+    /// @brief 新连接是否使用边缘触发。
+    bool edgeTriggered_;
+    /// @brief 新连接的 SO_BUSY_POLL 时间(微秒), 0 表示不设置。
+    int socketBusyPollUs_;
+    /// @brief 新连接的读取预算, 0 表示使用默认值。
+    size_t readBudget_;
+    /// @brief 新连接使用零拷贝发送的最小字节数, 0 表示关闭。
+    size_t zeroCopyThreshold_;
+    /// @brief 连接缓冲区的内存预算, 为空表示不限制。
+    std::shared_ptr<MemoryBudget> memoryBudget_;
 };
\ No newline at end of file
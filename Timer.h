@@ -0,0 +1,57 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+/**
+ * @brief Timer 是对一个定时任务的封装。
+ * @details
+ * 它记录了到期时间、到期后要执行的回调以及重复间隔。
+ * Timer 对象由 TimerQueue 独占管理, 用户只能通过 TimerId 间接地取消它。
+ */
+class Timer : noncopyable
+{
+public:
+    /**
+     * @brief 构造函数。
+     * @param cb 到期时执行的回调。
+     * @param when 第一次到期的时间。
+     * @param interval 重复间隔(秒)。大于0表示这是一个周期定时器。
+     */
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb)),
+          expiration_(when),
+          interval_(interval),
+          repeat_(interval > 0.0),
+          sequence_(++s_numCreated_)
+    {
+    }
+
+    /// @brief 执行定时器回调。
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    /**
+     * @brief 重启一个周期定时器, 计算它的下一次到期时间。
+     * @param now 当前时间。
+     */
+    void restart(Timestamp now);
+
+    static int64_t numCreated() { return s_numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;
+    const bool repeat_;
+    /// @brief 全局唯一的序列号, 用于区分地址被复用的不同 Timer 对象。
+    const int64_t sequence_;
+
+    static std::atomic<int64_t> s_numCreated_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+/**
+ * @brief TimerId 是暴露给用户的定时器句柄, 用于取消定时器。
+ * @details
+ * 它只保存了 Timer 的地址和序列号, 不拥有 Timer 对象。
+ * 序列号用于区分先后分配在同一地址上的两个不同 Timer, 保证 cancel 的正确性。
+ */
+class TimerId
+{
+public:
+    TimerId()
+        : timer_(nullptr),
+          sequence_(0)
+    {
+    }
+
+    TimerId(Timer *timer, int64_t seq)
+        : timer_(timer),
+          sequence_(seq)
+    {
+    }
+
+    friend class TimerQueue;
+
+private:
+    Timer *timer_;
+    int64_t sequence_;
+};
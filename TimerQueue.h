@@ -0,0 +1,84 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Channel.h"
+#include "Callbacks.h"
+
+#include <set>
+#include <vector>
+#include <atomic>
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/**
+ * @brief TimerQueue 是 EventLoop 的定时器管理器。
+ * @details
+ * 它使用一个 timerfd 作为时钟源, 并将其封装为 Channel 注册到 Poller 中,
+ * 这样定时器事件就和普通的 I/O 事件一样在 EventLoop::loop() 中被统一处理,
+ * 不需要任何额外的线程。
+ * 所有定时器按到期时间排序保存在一棵平衡二叉树(std::set)中,
+ * 添加和取消都是 O(log n)。timerfd 始终只设置为最早到期的那个时间点,
+ * 因此无论有多少定时器, 每次到期都只会产生一次唤醒。
+ * @note 除 addTimer/cancel 外, 其他成员函数只能在所属的 EventLoop 线程中调用。
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    /**
+     * @brief 添加一个定时器。
+     * @param cb 定时器到期时执行的回调。
+     * @param when 到期时间。
+     * @param interval 重复间隔(秒), 小于等于0表示只执行一次。
+     * @return TimerId 可用于取消该定时器的句柄。
+     * @note 线程安全, 可以在任意线程中调用。
+     */
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+    /**
+     * @brief 取消一个定时器。
+     * @note 线程安全, 可以在任意线程中调用。
+     */
+    void cancel(TimerId timerId);
+
+private:
+    /// @brief 按到期时间排序, 使用 Timer* 作为第二关键字区分同一时刻到期的不同定时器
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    /// @brief 按 Timer 地址排序, 用于 cancel 时的 O(log n) 查找
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+
+    /// @brief timerfd 可读时的回调, 执行所有已到期的定时器
+    void handleRead();
+
+    /// @brief 从 timers_ 中移除所有已到期的定时器并返回
+    std::vector<Entry> getExpired(Timestamp now);
+    /// @brief 重新插入周期定时器, 并重设 timerfd
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+
+    /// @brief 插入一个定时器, 返回最早到期时间是否因此改变
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    /// @brief 按到期时间排序的定时器列表
+    TimerList timers_;
+
+    /// @brief 与 timers_ 保存相同的定时器, 但按地址排序
+    ActiveTimerSet activeTimers_;
+    /// @brief 标识当前是否正在执行到期定时器的回调
+    std::atomic_bool callingExpiredTimers_;
+    /// @brief 在执行回调期间被取消的定时器, 防止周期定时器在 reset 中被重新插入
+    ActiveTimerSet cancelingTimers_;
+};
@@ -7,24 +7,60 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 {
 }
 
+// 将clock_gettime得到的timespec换算成微秒
+static int64_t clockMicroseconds(clockid_t clockId)
+{
+    struct timespec ts;
+    clock_gettime(clockId, &ts);
+    int64_t seconds = ts.tv_sec;
+    return seconds * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    return Timestamp(clockMicroseconds(CLOCK_REALTIME));
 };
 
+Timestamp Timestamp::monotonicNow()
+{
+    return Timestamp(clockMicroseconds(CLOCK_MONOTONIC));
+}
+
 std::string Timestamp::toString() const
+{
+    return toFormattedString(false);
+};
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm tm_time;
+    localtime_r(&seconds, &tm_time); // localtime 返回静态缓冲区, 多线程下不安全
+    if (showMicroseconds)
+    {
+        int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d.%06d",
+                 tm_time.tm_year + 1900,
+                 tm_time.tm_mon + 1,
+                 tm_time.tm_mday,
+                 tm_time.tm_hour,
+                 tm_time.tm_min,
+                 tm_time.tm_sec,
+                 microseconds);
+    }
+    else
+    {
+        snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
+                 tm_time.tm_year + 1900,
+                 tm_time.tm_mon + 1,
+                 tm_time.tm_mday,
+                 tm_time.tm_hour,
+                 tm_time.tm_min,
+                 tm_time.tm_sec);
+    }
     return buf;
-};
+}
 
 // #include <iostream>
 
@@ -32,4 +68,4 @@ std::string Timestamp::toString() const
 // {
 //     std::cout<<Timestamp::now().toString()<<std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
@@ -10,9 +10,63 @@ public:
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
 
+    /**
+     * @brief 获取当前的墙上时间(CLOCK_REALTIME), 微秒精度。
+     */
     static Timestamp now();
+    /**
+     * @brief 获取单调时钟(CLOCK_MONOTONIC)的当前值, 微秒精度。
+     * @note 返回值的起点是系统启动时刻而不是Epoch, 不受系统时间调整的影响,
+     * 只适合用来计算时间间隔(如排队延迟), 不能用 toString() 格式化。
+     */
+    static Timestamp monotonicNow();
+    /// @brief 返回一个无效的时间戳(值为0), 用于表示“未设置”。
+    static Timestamp invalid() { return Timestamp(); }
+
     std::string toString() const;
+    /**
+     * @brief 格式化为 "年/月/日 时:分:秒[.微秒]"。
+     * @param showMicroseconds 是否附带6位微秒部分。
+     */
+    std::string toFormattedString(bool showMicroseconds = true) const;
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+/**
+ * @brief 计算两个时间戳的差值。
+ * @return double 以秒为单位的 high - low。
+ */
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+/**
+ * @brief 在给定时间戳上增加若干秒。
+ * @param timestamp 基准时间戳。
+ * @param seconds 需要增加的秒数(可以是小数)。
+ * @return Timestamp timestamp + seconds。
+ */
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,127 @@
+#include "TimingWheel.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+TimingWheel::TimingWheel(EventLoop *loop, int idleSeconds)
+    : loop_(loop),
+      buckets_(idleSeconds + 1),
+      cursor_(0)
+{
+    for (size_t i = 0; i < buckets_.size(); ++i)
+    {
+        // 哨兵节点自成一个空的循环链表
+        buckets_[i].prev = &buckets_[i];
+        buckets_[i].next = &buckets_[i];
+        buckets_[i].bucket = static_cast<int>(i);
+    }
+}
+
+TimingWheel::~TimingWheel()
+{
+    // 仍然挂在桶里的连接(如果有)只需要摘链即可, 它们的生命周期不归时间轮管理
+    for (Entry &head : buckets_)
+    {
+        while (head.next != &head)
+        {
+            unlink(head.next);
+        }
+    }
+}
+
+void TimingWheel::start()
+{
+    // 定时器只持有弱引用, TcpServer 析构后回调自动失效
+    std::weak_ptr<TimingWheel> weakWheel(shared_from_this());
+    tickTimer_ = loop_->runEvery(1.0, [weakWheel]() {
+        std::shared_ptr<TimingWheel> wheel = weakWheel.lock();
+        if (wheel)
+        {
+            wheel->onTick();
+        }
+    });
+}
+
+void TimingWheel::stop()
+{
+    loop_->cancel(tickTimer_);
+}
+
+void TimingWheel::add(Entry *entry, const TcpConnectionPtr &conn)
+{
+    entry->conn = conn;
+    touch(entry);
+}
+
+void TimingWheel::touch(Entry *entry)
+{
+    // 同一秒内的多次读事件只需要第一次挪动
+    if (entry->bucket == cursor_)
+    {
+        return;
+    }
+    if (entry->bucket >= 0)
+    {
+        unlink(entry);
+    }
+    link(entry, cursor_);
+}
+
+void TimingWheel::remove(Entry *entry)
+{
+    if (entry->bucket >= 0)
+    {
+        unlink(entry);
+    }
+}
+
+void TimingWheel::onTick()
+{
+    cursor_ = (cursor_ + 1) % static_cast<int>(buckets_.size());
+
+    // 先把到期的桶整体摘到局部链表中, 防止关闭连接的回调修改正在遍历的桶
+    Entry expired;
+    Entry &head = buckets_[cursor_];
+    if (head.next == &head)
+    {
+        return;
+    }
+    expired.next = head.next;
+    expired.prev = head.prev;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    head.next = &head;
+    head.prev = &head;
+
+    while (expired.next != &expired)
+    {
+        Entry *entry = expired.next;
+        unlink(entry);
+        TcpConnectionPtr conn = entry->conn.lock();
+        if (conn)
+        {
+            LOG_INFO("TimingWheel::onTick connection [%s] idle for %d seconds, force close\n",
+                     conn->name().c_str(), idleSeconds());
+            conn->forceClose();
+        }
+    }
+}
+
+void TimingWheel::link(Entry *entry, int bucket)
+{
+    Entry &head = buckets_[bucket];
+    entry->prev = head.prev;
+    entry->next = &head;
+    head.prev->next = entry;
+    head.prev = entry;
+    entry->bucket = bucket;
+}
+
+void TimingWheel::unlink(Entry *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = nullptr;
+    entry->next = nullptr;
+    entry->bucket = -1;
+}
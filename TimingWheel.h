@@ -0,0 +1,80 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+
+#include <memory>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief TimingWheel 是一个按秒分桶的时间轮, 用于踢掉长时间空闲的连接。
+ * @details
+ * 时间轮共有 idleSeconds + 1 个桶, 每秒转动一格。连接每次收到数据时,
+ * 就被挪到“最新”的桶里; 当指针转回到某个桶时, 桶里的连接已经至少
+ * idleSeconds 秒没有收到数据, 会被强制关闭。
+ * 每个桶是一个侵入式的双向循环链表, 链表节点(Entry)直接嵌在 TcpConnection 中,
+ * 因此 touch 只是一次 O(1) 的摘链和挂链, 没有任何内存分配。
+ * Entry 通过 weak_ptr 引用连接, 不会延长连接的生命周期。
+ * @note 每个 EventLoop 一个实例, 除 stop() 外所有接口只能在所属 loop 线程中调用。
+ */
+class TimingWheel : noncopyable, public std::enable_shared_from_this<TimingWheel>
+{
+public:
+    /// @brief 时间轮链表节点, 由 TcpConnection 持有
+    struct Entry
+    {
+        Entry() : prev(nullptr), next(nullptr), bucket(-1) {}
+
+        std::weak_ptr<TcpConnection> conn;
+        Entry *prev;
+        Entry *next;
+        /// @brief 当前所在的桶, -1 表示不在时间轮中
+        int bucket;
+    };
+
+    /**
+     * @brief 构造函数。
+     * @param loop 时间轮所属的 EventLoop。
+     * @param idleSeconds 连接允许空闲的秒数。
+     */
+    TimingWheel(EventLoop *loop, int idleSeconds);
+    ~TimingWheel();
+
+    /**
+     * @brief 启动每秒一次的转动定时器。
+     * @note 对象必须已经由 shared_ptr 管理。线程安全。
+     */
+    void start();
+
+    /**
+     * @brief 停止转动定时器。
+     * @note 线程安全, 但调用时所属的 EventLoop 必须仍然存活。
+     */
+    void stop();
+
+    /// @brief 将一个新连接放入最新的桶
+    void add(Entry *entry, const TcpConnectionPtr &conn);
+    /// @brief 连接有活动, 将其挪到最新的桶, O(1)
+    void touch(Entry *entry);
+    /// @brief 将连接从时间轮中移除
+    void remove(Entry *entry);
+
+    int idleSeconds() const { return static_cast<int>(buckets_.size()) - 1; }
+
+private:
+    /// @brief 每秒执行一次, 转动指针并关闭到期桶中的连接
+    void onTick();
+
+    void link(Entry *entry, int bucket);
+    static void unlink(Entry *entry);
+
+    EventLoop *loop_;
+    /// @brief 每个桶的哨兵节点
+    std::vector<Entry> buckets_;
+    /// @brief 指向“最新”的桶
+    int cursor_;
+    TimerId tickTimer_;
+};
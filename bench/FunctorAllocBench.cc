@@ -0,0 +1,86 @@
+// 对比 std::function 与 EventLoop::Functor(InplaceFunction) 在投递任务时的堆分配次数。
+// 通过替换全局 operator new 来统计分配次数, 模拟 TcpConnection::send 跨线程投递时的典型捕获:
+// 一个 shared_ptr 加一个短 std::string。
+#include "EventLoop.h"
+#include "MpscQueue.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+
+static std::atomic<size_t> g_allocations{0};
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+static const int kTasks = 1000000;
+
+// 把 kTasks 个任务经过 MpscQueue 入队再出队执行, 这正是 queueInLoop/doPendingFunctors 的路径
+template <typename Task>
+static void runBench(const char *name)
+{
+    MpscQueue<Task> queue;
+    std::shared_ptr<int> conn = std::make_shared<int>(0);
+    long sum = 0;
+
+    // 预热: 让 MpscQueue 的节点回收池进入稳定状态
+    for (int i = 0; i < 1024; ++i)
+    {
+        queue.push(Task([conn, &sum]() { ++sum; }));
+    }
+    Task task;
+    while (queue.pop(&task))
+    {
+        task();
+    }
+
+    size_t before = g_allocations.load();
+    Timestamp start = Timestamp::monotonicNow();
+    for (int i = 0; i < kTasks; ++i)
+    {
+        std::string msg("short reply");
+        queue.push(Task([conn, msg, &sum]() { sum += static_cast<long>(msg.size()); }));
+        if (queue.pop(&task))
+        {
+            task();
+        }
+    }
+    double seconds = timeDifference(Timestamp::monotonicNow(), start);
+    size_t allocations = g_allocations.load() - before;
+
+    printf("%-28s allocations/task: %.3f  ns/task: %.1f  (checksum %ld)\n",
+           name,
+           static_cast<double>(allocations) / kTasks,
+           seconds * 1e9 / kTasks,
+           sum);
+}
+
+int main()
+{
+    runBench<std::function<void()>>("std::function<void()>");
+    runBench<EventLoop::Functor>("EventLoop::Functor");
+    return 0;
+}
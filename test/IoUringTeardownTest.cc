@@ -0,0 +1,125 @@
+// 析构一个开启了完成式收发(setCompletionIo)、仍有活动连接的 TcpServer。
+// 每个连接都有一个进行中的异步 recv, 一半的连接还有一个因为对端不读而挂起的异步 send。
+// 析构服务器和线程池之后, 所有连接对象都必须已经释放(在 ASan 下还能发现 ring 析构时的释放后使用)。
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "IoUringPoller.h"
+#include "InetAddress.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const int kNumClients = 16;
+static const uint16_t kPort = 19731;
+
+static int connectClient()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    // 接收缓冲区很小, 服务器发送的大块数据会把异步 send 挂起
+    int rcvbuf = 4096;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+int main()
+{
+    if (!IoUringPoller::isSupported())
+    {
+        printf("io_uring is not supported, skipped\n");
+        return 0;
+    }
+    ::signal(SIGPIPE, SIG_IGN);
+    ::setenv("MUDUO_USE_IOURING", "1", 1); // I/O 线程的 EventLoop 也使用 io_uring
+
+    std::mutex mutex;
+    std::vector<std::weak_ptr<TcpConnection>> conns;
+    std::atomic<int> connected(0);
+    std::vector<int> clients;
+    {
+        EventLoop loop;
+        std::unique_ptr<TcpServer> server(new TcpServer(&loop, InetAddress(kPort), "TeardownTest"));
+        server->setThreadNum(2);
+        server->setCompletionIo(true);
+        server->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                conns.push_back(conn);
+                if (conns.size() % 2 == 0)
+                {
+                    conn->send(std::string(8 * 1024 * 1024, 'x'));
+                }
+            }
+            ++connected;
+        });
+        server->start();
+
+        loop.runAfter(0.1, [&]() {
+            for (int i = 0; i < kNumClients; ++i)
+            {
+                clients.push_back(connectClient());
+            }
+        });
+        loop.runEvery(0.05, [&]() {
+            if (connected == kNumClients)
+            {
+                loop.runAfter(0.2, [&]() { loop.quit(); }); // 让异步 send 填满发送缓冲区
+            }
+        });
+        loop.runAfter(5.0, [&]() { loop.quit(); });
+        loop.loop();
+
+        if (connected != kNumClients)
+        {
+            fprintf(stderr, "only %d of %d clients connected\n", connected.load(), kNumClients);
+            return 1;
+        }
+        // 连接仍然活动, 异步 recv/send 还在 ring 中
+        server.reset();
+    }
+
+    int alive = 0;
+    for (const std::weak_ptr<TcpConnection> &conn : conns)
+    {
+        if (!conn.expired())
+        {
+            ++alive;
+        }
+    }
+    for (int fd : clients)
+    {
+        ::close(fd);
+    }
+    if (alive != 0)
+    {
+        fprintf(stderr, "%d connections still alive after the server was destroyed\n", alive);
+        return 1;
+    }
+    printf("ok: %d connections destroyed with completion io in flight\n", kNumClients);
+    return 0;
+}